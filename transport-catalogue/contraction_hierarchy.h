@@ -0,0 +1,465 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Contraction hierarchy over DirectedWeightedGraph: vertices are contracted one by one
+// (lowest edge difference first), shortcuts keep distances between the remaining ones.
+// Queries are bidirectional Dijkstra searches that only go up in the hierarchy,
+// found shortcuts are unpacked back into the original graph edges.
+template <typename Weight>
+class ContractionHierarchy {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using ArcId = size_t;
+
+public:
+    static constexpr ArcId NO_ARC = std::numeric_limits<ArcId>::max();
+
+    // Original graph edge (first == NO_ARC) or shortcut over the arcs first and second
+    struct Arc {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        EdgeId edge = 0;
+        ArcId first = NO_ARC;
+        ArcId second = NO_ARC;
+    };
+
+    explicit ContractionHierarchy(const Graph& graph);
+    // Restores a hierarchy from previously contracted arcs and vertex ranks
+    ContractionHierarchy(std::vector<Arc> arcs, std::vector<size_t> ranks);
+
+    // Returns route weight and fills edges with the original edge ids of the route
+    std::optional<Weight> BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+
+    size_t GetShortcutCount() const {
+        return shortcut_count_;
+    }
+    size_t GetVertexCount() const {
+        return vertex_count_;
+    }
+    const std::vector<Arc>& GetArcs() const {
+        return arcs_;
+    }
+    const std::vector<size_t>& GetRanks() const {
+        return ranks_;
+    }
+
+private:
+    static constexpr size_t MAX_WITNESS_SETTLED = 500;
+
+    struct Shortcut {
+        ArcId first;
+        ArcId second;
+        Weight weight;
+    };
+
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    struct SearchSpace {
+        std::vector<std::optional<Weight>> distances;
+        std::vector<ArcId> parents;
+        std::vector<VertexId> touched;
+
+        void Prepare(size_t vertex_count) {
+            if (distances.size() < vertex_count) {
+                distances.resize(vertex_count);
+                parents.resize(vertex_count, NO_ARC);
+            }
+        }
+
+        void Update(VertexId vertex, Weight weight, ArcId parent) {
+            if (!distances[vertex]) {
+                touched.push_back(vertex);
+            }
+            distances[vertex] = weight;
+            parents[vertex] = parent;
+        }
+
+        void Clear() {
+            for (const VertexId vertex : touched) {
+                distances[vertex].reset();
+                parents[vertex] = NO_ARC;
+            }
+            touched.clear();
+        }
+    };
+
+    // State used only while the hierarchy is being built
+    struct ContractionState {
+        std::vector<std::vector<ArcId>> out_arcs;
+        std::vector<std::vector<ArcId>> in_arcs;
+        std::vector<bool> is_contracted;
+        std::vector<int> contracted_neighbors;
+        std::vector<size_t> neighbour_positions;
+        std::vector<bool> is_witness_target;
+        SearchSpace witness;
+    };
+
+    void AddArc(ContractionState& state, Arc arc) {
+        const ArcId id = arcs_.size();
+        state.out_arcs[arc.from].push_back(id);
+        state.in_arcs[arc.to].push_back(id);
+        arcs_.push_back(std::move(arc));
+    }
+
+    void RemoveContractedArcs(const ContractionState& state, std::vector<ArcId>& arcs) const {
+        arcs.erase(std::remove_if(arcs.begin(), arcs.end(), [this, &state](ArcId arc_id) {
+            return state.is_contracted[arcs_[arc_id].from] || state.is_contracted[arcs_[arc_id].to];
+        }), arcs.end());
+    }
+
+    // Keeps the lightest arc to every uncontracted neighbour
+    std::vector<ArcId> CollectActiveArcs(ContractionState& state, VertexId vertex, bool outgoing) const {
+        std::vector<ArcId> result;
+        const auto& arcs = outgoing ? state.out_arcs[vertex] : state.in_arcs[vertex];
+        for (const ArcId arc_id : arcs) {
+            const VertexId neighbour = outgoing ? arcs_[arc_id].to : arcs_[arc_id].from;
+            if (state.is_contracted[neighbour]) {
+                continue;
+            }
+            size_t& position = state.neighbour_positions[neighbour];
+            if (position == NO_ARC) {
+                position = result.size();
+                result.push_back(arc_id);
+            }
+            else if (arcs_[arc_id].weight < arcs_[result[position]].weight) {
+                result[position] = arc_id;
+            }
+        }
+        for (const ArcId arc_id : result) {
+            state.neighbour_positions[outgoing ? arcs_[arc_id].to : arcs_[arc_id].from] = NO_ARC;
+        }
+        return result;
+    }
+
+    // Stops as soon as every target is settled, the limit is exceeded or the search grows too large
+    void RunWitnessSearch(ContractionState& state, VertexId source, VertexId excluded, Weight limit,
+                          size_t targets_count) const {
+        SearchSpace& witness = state.witness;
+        witness.Clear();
+        witness.Update(source, ZERO_WEIGHT, NO_ARC);
+        Queue queue;
+        queue.push({ZERO_WEIGHT, source});
+        size_t settled_count = 0;
+        while (!queue.empty() && settled_count < MAX_WITNESS_SETTLED) {
+            const QueueItem item = queue.top();
+            queue.pop();
+            if (limit < item.weight) {
+                break;
+            }
+            if (*witness.distances[item.vertex] < item.weight) {
+                continue;
+            }
+            ++settled_count;
+            if (state.is_witness_target[item.vertex] && --targets_count == 0) {
+                break;
+            }
+            for (const ArcId arc_id : state.out_arcs[item.vertex]) {
+                const Arc& arc = arcs_[arc_id];
+                if (arc.to == excluded || state.is_contracted[arc.to]) {
+                    continue;
+                }
+                const Weight candidate_weight = item.weight + arc.weight;
+                const auto& distance = witness.distances[arc.to];
+                if (!distance || candidate_weight < *distance) {
+                    witness.Update(arc.to, candidate_weight, arc_id);
+                    queue.push({candidate_weight, arc.to});
+                }
+            }
+        }
+    }
+
+    std::vector<Shortcut> FindShortcuts(ContractionState& state, VertexId vertex,
+                                        const std::vector<ArcId>& in_arcs,
+                                        const std::vector<ArcId>& out_arcs) const {
+        std::vector<Shortcut> result;
+        if (in_arcs.empty() || out_arcs.empty()) {
+            return result;
+        }
+
+        Weight max_out_weight = arcs_[out_arcs.front()].weight;
+        for (const ArcId arc_id : out_arcs) {
+            if (max_out_weight < arcs_[arc_id].weight) {
+                max_out_weight = arcs_[arc_id].weight;
+            }
+            state.is_witness_target[arcs_[arc_id].to] = true;
+        }
+
+        for (const ArcId in_arc_id : in_arcs) {
+            const Arc& in_arc = arcs_[in_arc_id];
+            RunWitnessSearch(state, in_arc.from, vertex, in_arc.weight + max_out_weight, out_arcs.size());
+            for (const ArcId out_arc_id : out_arcs) {
+                const Arc& out_arc = arcs_[out_arc_id];
+                if (out_arc.to == in_arc.from) {
+                    continue;
+                }
+                const Weight shortcut_weight = in_arc.weight + out_arc.weight;
+                const auto& witness_distance = state.witness.distances[out_arc.to];
+                if (!witness_distance || shortcut_weight < *witness_distance) {
+                    result.push_back({in_arc_id, out_arc_id, shortcut_weight});
+                }
+            }
+        }
+        for (const ArcId arc_id : out_arcs) {
+            state.is_witness_target[arcs_[arc_id].to] = false;
+        }
+        return result;
+    }
+
+    void Contract(const Graph& graph);
+    void CollectUpwardArcs();
+    void UnpackArc(ArcId arc_id, std::vector<EdgeId>& edges) const;
+
+    void SearchStep(Queue& queue, SearchSpace& space, const SearchSpace& other_space,
+                    const std::vector<std::vector<ArcId>>& upward_arcs, bool is_forward,
+                    std::optional<Weight>& best_weight, VertexId& meeting_vertex) const {
+        const QueueItem item = queue.top();
+        queue.pop();
+        if (*space.distances[item.vertex] < item.weight) {
+            return;
+        }
+        if (const auto& other_distance = other_space.distances[item.vertex]) {
+            const Weight candidate_weight = item.weight + *other_distance;
+            if (!best_weight || candidate_weight < *best_weight) {
+                best_weight = candidate_weight;
+                meeting_vertex = item.vertex;
+            }
+        }
+        for (const ArcId arc_id : upward_arcs[item.vertex]) {
+            const Arc& arc = arcs_[arc_id];
+            const VertexId next = is_forward ? arc.to : arc.from;
+            const Weight candidate_weight = item.weight + arc.weight;
+            const auto& distance = space.distances[next];
+            if (!distance || candidate_weight < *distance) {
+                space.Update(next, candidate_weight, arc_id);
+                queue.push({candidate_weight, next});
+            }
+        }
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    size_t vertex_count_ = 0;
+    size_t shortcut_count_ = 0;
+    std::vector<Arc> arcs_;
+    std::vector<size_t> ranks_;
+    // upward_out_arcs_[v]: arcs v -> w with rank(w) > rank(v), used by the forward search
+    // upward_in_arcs_[v]: arcs u -> v with rank(u) > rank(v), used by the backward search
+    std::vector<std::vector<ArcId>> upward_out_arcs_;
+    std::vector<std::vector<ArcId>> upward_in_arcs_;
+};
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph)
+    : vertex_count_(graph.GetVertexCount())
+    , ranks_(graph.GetVertexCount(), 0)
+{
+    Contract(graph);
+    CollectUpwardArcs();
+}
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(std::vector<Arc> arcs, std::vector<size_t> ranks)
+    : vertex_count_(ranks.size())
+    , arcs_(std::move(arcs))
+    , ranks_(std::move(ranks))
+{
+    for (const Arc& arc : arcs_) {
+        if (arc.from >= vertex_count_ || arc.to >= vertex_count_
+            || (arc.first != NO_ARC && (arc.first >= arcs_.size() || arc.second >= arcs_.size()))) {
+            throw std::invalid_argument("Broken contraction hierarchy arc");
+        }
+        if (arc.first != NO_ARC) {
+            ++shortcut_count_;
+        }
+    }
+    CollectUpwardArcs();
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::Contract(const Graph& graph) {
+    ContractionState state;
+    state.out_arcs.resize(vertex_count_);
+    state.in_arcs.resize(vertex_count_);
+    state.is_contracted.assign(vertex_count_, false);
+    state.contracted_neighbors.assign(vertex_count_, 0);
+    state.neighbour_positions.assign(vertex_count_, NO_ARC);
+    state.is_witness_target.assign(vertex_count_, false);
+    state.witness.Prepare(vertex_count_);
+
+    arcs_.reserve(graph.GetEdgeCount());
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        if (edge.from != edge.to) {
+            AddArc(state, {edge.from, edge.to, edge.weight, edge_id});
+        }
+    }
+
+    auto compute_priority = [&state](VertexId vertex, size_t shortcuts, size_t in_degree, size_t out_degree) {
+        return static_cast<int>(shortcuts) - static_cast<int>(in_degree + out_degree)
+            + state.contracted_neighbors[vertex];
+    };
+
+    using PriorityItem = std::pair<int, VertexId>;
+    std::priority_queue<PriorityItem, std::vector<PriorityItem>, std::greater<PriorityItem>> queue;
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        const auto in_arcs = CollectActiveArcs(state, vertex, false);
+        const auto out_arcs = CollectActiveArcs(state, vertex, true);
+        const size_t shortcuts = FindShortcuts(state, vertex, in_arcs, out_arcs).size();
+        queue.push({compute_priority(vertex, shortcuts, in_arcs.size(), out_arcs.size()), vertex});
+    }
+
+    size_t next_rank = 0;
+    while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+
+        // Lazy update: the priority may have grown since the vertex was queued
+        const auto in_arcs = CollectActiveArcs(state, vertex, false);
+        const auto out_arcs = CollectActiveArcs(state, vertex, true);
+        std::vector<Shortcut> shortcuts = FindShortcuts(state, vertex, in_arcs, out_arcs);
+        const int priority = compute_priority(vertex, shortcuts.size(), in_arcs.size(), out_arcs.size());
+        if (!queue.empty() && priority > queue.top().first) {
+            queue.push({priority, vertex});
+            continue;
+        }
+
+        state.is_contracted[vertex] = true;
+        ranks_[vertex] = next_rank++;
+        for (const Shortcut& shortcut : shortcuts) {
+            AddArc(state, {arcs_[shortcut.first].from, arcs_[shortcut.second].to, shortcut.weight,
+                           0, shortcut.first, shortcut.second});
+        }
+        shortcut_count_ += shortcuts.size();
+        for (const ArcId arc_id : in_arcs) {
+            const VertexId neighbour = arcs_[arc_id].from;
+            ++state.contracted_neighbors[neighbour];
+            RemoveContractedArcs(state, state.out_arcs[neighbour]);
+        }
+        for (const ArcId arc_id : out_arcs) {
+            const VertexId neighbour = arcs_[arc_id].to;
+            ++state.contracted_neighbors[neighbour];
+            RemoveContractedArcs(state, state.in_arcs[neighbour]);
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::CollectUpwardArcs() {
+    upward_out_arcs_.resize(vertex_count_);
+    upward_in_arcs_.resize(vertex_count_);
+    for (ArcId arc_id = 0; arc_id < arcs_.size(); ++arc_id) {
+        const Arc& arc = arcs_[arc_id];
+        if (ranks_[arc.from] < ranks_[arc.to]) {
+            upward_out_arcs_[arc.from].push_back(arc_id);
+        }
+        else {
+            upward_in_arcs_[arc.to].push_back(arc_id);
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UnpackArc(ArcId arc_id, std::vector<EdgeId>& edges) const {
+    std::vector<ArcId> stack{arc_id};
+    while (!stack.empty()) {
+        const Arc& arc = arcs_[stack.back()];
+        stack.pop_back();
+        if (arc.first == NO_ARC) {
+            edges.push_back(arc.edge);
+        }
+        else {
+            stack.push_back(arc.second);
+            stack.push_back(arc.first);
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<Weight> ContractionHierarchy<Weight>::BuildRoute(VertexId from, VertexId to,
+                                                               std::vector<EdgeId>& edges) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    edges.clear();
+    if (from == to) {
+        return ZERO_WEIGHT;
+    }
+
+    thread_local SearchSpace forward_space;
+    thread_local SearchSpace backward_space;
+    forward_space.Prepare(vertex_count_);
+    backward_space.Prepare(vertex_count_);
+
+    Queue forward_queue;
+    Queue backward_queue;
+    forward_space.Update(from, ZERO_WEIGHT, NO_ARC);
+    forward_queue.push({ZERO_WEIGHT, from});
+    backward_space.Update(to, ZERO_WEIGHT, NO_ARC);
+    backward_queue.push({ZERO_WEIGHT, to});
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+    bool is_forward_turn = true;
+    while (true) {
+        const bool is_forward_active = !forward_queue.empty()
+            && (!best_weight || forward_queue.top().weight < *best_weight);
+        const bool is_backward_active = !backward_queue.empty()
+            && (!best_weight || backward_queue.top().weight < *best_weight);
+        if (!is_forward_active && !is_backward_active) {
+            break;
+        }
+        if (is_forward_active && (is_forward_turn || !is_backward_active)) {
+            SearchStep(forward_queue, forward_space, backward_space, upward_out_arcs_, true,
+                       best_weight, meeting_vertex);
+        }
+        else {
+            SearchStep(backward_queue, backward_space, forward_space, upward_in_arcs_, false,
+                       best_weight, meeting_vertex);
+        }
+        is_forward_turn = !is_forward_turn;
+    }
+
+    if (best_weight) {
+        std::vector<ArcId> forward_arcs;
+        for (VertexId vertex = meeting_vertex; forward_space.parents[vertex] != NO_ARC;
+             vertex = arcs_[forward_space.parents[vertex]].from) {
+            forward_arcs.push_back(forward_space.parents[vertex]);
+        }
+        for (auto it = forward_arcs.rbegin(); it != forward_arcs.rend(); ++it) {
+            UnpackArc(*it, edges);
+        }
+        for (VertexId vertex = meeting_vertex; backward_space.parents[vertex] != NO_ARC;
+             vertex = arcs_[backward_space.parents[vertex]].to) {
+            UnpackArc(backward_space.parents[vertex], edges);
+        }
+    }
+
+    forward_space.Clear();
+    backward_space.Clear();
+    return best_weight;
+}
+
+}  // namespace graph
@@ -2,21 +2,41 @@
 
 #include "geo.h"
 
+#include <cstdint>
 #include <string>
-#include <set>
 #include <vector>
 
 namespace transport_catalogue {
+	// Dense ids given in the order stops and buses are added to the catalogue
+	using StopId = uint32_t;
+	using BusId = uint32_t;
+
 	struct Stop {
 		std::string name;
 		geo::Coordinates coordinates;
-		std::set<std::string> buses;
+		// Trigonometry of the coordinates for route lengths and the stop index
+		geo::PreparedCoordinates prepared_coordinates;
+		// Buses calling at the stop, ordered by number
+		std::vector<BusId> buses;
+		StopId id = 0;
 	};
 
 	struct Bus {
 		std::string number;
 		std::vector<const Stop*> stops;
 		bool is_roundtrip = false;
+		BusId id = 0;
+	};
+
+	struct RoadDistance {
+		StopId to = 0;
+		int distance = 0;
+	};
+
+	struct NearbyStop {
+		const Stop* stop = nullptr;
+		// Great-circle distance in meters
+		double distance = 0.0;
 	};
 
 	struct BusInfo {
@@ -26,10 +46,4 @@ namespace transport_catalogue {
 		double geo_route_length = 0.0;
 		double curvature = 0.0;
 	};
-
-	struct StopPairHasher {
-		static const size_t salt = 37;
-
-		size_t operator()(const std::pair<const Stop*, const Stop*>& stops) const;
-	};
 } // namespace transport_catalogue
\ No newline at end of file
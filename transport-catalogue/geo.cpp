@@ -1,10 +1,135 @@
 #define _USE_MATH_DEFINES
 #include "geo.h"
 
+#include <algorithm>
 #include <cmath>
+#include <iterator>
+
+// The AVX2 kernel is compiled for x86 with GCC or Clang whatever the flags, and picked at run time
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEO_AVX2_KERNEL
+#define AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
 
 namespace geo {
 
+    namespace {
+        constexpr double DEG_TO_RAD = M_PI / 180.;
+        constexpr int EARTH_RADIUS = 6371000;
+
+        double ComputeAngle(const PreparedCoordinates& from, const PreparedCoordinates& to) {
+            // Same as ComputeDistance: a repeated stop adds exactly nothing
+            if (from.sin_lat == to.sin_lat && from.cos_lat == to.cos_lat
+                && from.sin_lng == to.sin_lng && from.cos_lng == to.cos_lng) {
+                return 0;
+            }
+            const double cos_dlng = from.cos_lng * to.cos_lng + from.sin_lng * to.sin_lng;
+            const double cos_angle = from.sin_lat * to.sin_lat + from.cos_lat * to.cos_lat * cos_dlng;
+            // Rounding can push the cosine of coinciding points just past 1
+            return std::acos(std::clamp(cos_angle, -1., 1.));
+        }
+
+#ifdef GEO_AVX2_KERNEL
+        static_assert(sizeof(PreparedCoordinates) == 4 * sizeof(double), "a point must fill one AVX register");
+
+        struct PreparedBatch {
+            __m256d sin_lat;
+            __m256d cos_lat;
+            __m256d sin_lng;
+            __m256d cos_lng;
+        };
+
+        // Four points, one per register, turned into one register per field
+        AVX2_TARGET PreparedBatch LoadBatch(const PreparedCoordinates* points) {
+            const __m256d p0 = _mm256_loadu_pd(&points[0].sin_lat);
+            const __m256d p1 = _mm256_loadu_pd(&points[1].sin_lat);
+            const __m256d p2 = _mm256_loadu_pd(&points[2].sin_lat);
+            const __m256d p3 = _mm256_loadu_pd(&points[3].sin_lat);
+            const __m256d sin01 = _mm256_unpacklo_pd(p0, p1);
+            const __m256d cos01 = _mm256_unpackhi_pd(p0, p1);
+            const __m256d sin23 = _mm256_unpacklo_pd(p2, p3);
+            const __m256d cos23 = _mm256_unpackhi_pd(p2, p3);
+            return {
+                _mm256_permute2f128_pd(sin01, sin23, 0x20),
+                _mm256_permute2f128_pd(cos01, cos23, 0x20),
+                _mm256_permute2f128_pd(sin01, sin23, 0x31),
+                _mm256_permute2f128_pd(cos01, cos23, 0x31),
+            };
+        }
+
+        // asin(s) for 0 <= s <= 0.5 as s + s^3 * P(s^2), P fitted to within an ulp
+        AVX2_TARGET __m256d Asin(__m256d s) {
+            static constexpr double P[] = {
+                0.1666666666666665, 0.07500000000020764, 0.044642857103423646, 0.03038194736709848,
+                0.02237204763174451, 0.017355259955786323, 0.013929652902326633, 0.011875494382636922,
+                0.0078029494773533175, 0.01603551434914882, -0.010749050339697808, 0.028169218060881414,
+            };
+            const __m256d t = _mm256_mul_pd(s, s);
+            __m256d p = _mm256_set1_pd(P[std::size(P) - 1]);
+            for (size_t i = std::size(P) - 1; i-- > 0;) {
+                p = _mm256_add_pd(_mm256_mul_pd(p, t), _mm256_set1_pd(P[i]));
+            }
+            return _mm256_add_pd(s, _mm256_mul_pd(_mm256_mul_pd(s, t), p));
+        }
+
+        AVX2_TARGET __m256d Acos(__m256d x) {
+            const __m256d one = _mm256_set1_pd(1.);
+            const __m256d half = _mm256_set1_pd(0.5);
+            x = _mm256_max_pd(_mm256_min_pd(x, one), _mm256_set1_pd(-1.));
+            const __m256d a = _mm256_andnot_pd(_mm256_set1_pd(-0.), x);
+
+            // acos(a) is 2 asin(sqrt((1 - a) / 2)) above 0.5 and pi/2 - asin(a) below
+            const __m256d above_half = _mm256_cmp_pd(a, half, _CMP_GT_OQ);
+            const __m256d s = _mm256_blendv_pd(a, _mm256_sqrt_pd(_mm256_mul_pd(_mm256_sub_pd(one, a), half)), above_half);
+            const __m256d asin = Asin(s);
+            const __m256d angle = _mm256_blendv_pd(
+                _mm256_sub_pd(_mm256_set1_pd(M_PI_2), asin), _mm256_add_pd(asin, asin), above_half);
+
+            // acos(-a) = pi - acos(a)
+            const __m256d negative = _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_LT_OQ);
+            return _mm256_blendv_pd(angle, _mm256_sub_pd(_mm256_set1_pd(M_PI), angle), negative);
+        }
+
+        // Sum of the angles of the path's leading segments, four at a time. The number of
+        // points consumed is stored in done, the rest of the segments are left to the caller.
+        AVX2_TARGET double SumAnglesByFour(const PreparedCoordinates* points, size_t count, size_t& done) {
+            __m256d sum = _mm256_setzero_pd();
+            size_t i = 0;
+            for (; i + 4 < count; i += 4) {
+                const PreparedBatch from = LoadBatch(points + i);
+                const PreparedBatch to = LoadBatch(points + i + 1);
+                const __m256d cos_dlng = _mm256_add_pd(
+                    _mm256_mul_pd(from.cos_lng, to.cos_lng), _mm256_mul_pd(from.sin_lng, to.sin_lng));
+                const __m256d cos_angle = _mm256_add_pd(_mm256_mul_pd(from.sin_lat, to.sin_lat),
+                    _mm256_mul_pd(_mm256_mul_pd(from.cos_lat, to.cos_lat), cos_dlng));
+                // Lanes with coinciding points give 0, as in the scalar ComputeAngle
+                const __m256d same_point = _mm256_and_pd(
+                    _mm256_and_pd(_mm256_cmp_pd(from.sin_lat, to.sin_lat, _CMP_EQ_OQ), _mm256_cmp_pd(from.cos_lat, to.cos_lat, _CMP_EQ_OQ)),
+                    _mm256_and_pd(_mm256_cmp_pd(from.sin_lng, to.sin_lng, _CMP_EQ_OQ), _mm256_cmp_pd(from.cos_lng, to.cos_lng, _CMP_EQ_OQ)));
+                sum = _mm256_add_pd(sum, _mm256_andnot_pd(same_point, Acos(cos_angle)));
+            }
+            done = i;
+
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, sum);
+            return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        }
+
+        bool HasAvx2() {
+#ifdef __AVX2__
+            return true;
+#else
+            static const bool has_avx2 = [] {
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2") != 0;
+            }();
+            return has_avx2;
+#endif
+        }
+#endif
+    } // namespace
+
     bool Coordinates::operator==(const Coordinates& other) const {
         return lat == other.lat && lng == other.lng;
     }
@@ -17,11 +142,29 @@ namespace geo {
         if (from == to) {
             return 0;
         }
-        static const double dr = M_PI / 180.;
-        static const int earth_radius = 6371000;
-        return acos(sin(from.lat * dr) * sin(to.lat * dr)
-            + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr))
-            * earth_radius;
+        return acos(sin(from.lat * DEG_TO_RAD) * sin(to.lat * DEG_TO_RAD)
+            + cos(from.lat * DEG_TO_RAD) * cos(to.lat * DEG_TO_RAD) * cos(abs(from.lng - to.lng) * DEG_TO_RAD))
+            * EARTH_RADIUS;
+    }
+
+    PreparedCoordinates Prepare(Coordinates coordinates) {
+        const double lat = coordinates.lat * DEG_TO_RAD;
+        const double lng = coordinates.lng * DEG_TO_RAD;
+        return { std::sin(lat), std::cos(lat), std::sin(lng), std::cos(lng) };
+    }
+
+    double ComputePathLength(const PreparedCoordinates* points, size_t count) {
+        double angle = 0;
+        size_t i = 0;
+#ifdef GEO_AVX2_KERNEL
+        if (HasAvx2()) {
+            angle = SumAnglesByFour(points, count, i);
+        }
+#endif
+        for (; i + 1 < count; ++i) {
+            angle += ComputeAngle(points[i], points[i + 1]);
+        }
+        return angle * EARTH_RADIUS;
     }
 
 }  // namespace geo
\ No newline at end of file
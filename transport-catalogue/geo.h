@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 namespace geo {
 
     struct Coordinates {
@@ -11,4 +13,18 @@ namespace geo {
 
     double ComputeDistance(Coordinates from, Coordinates to);
 
+    // Trigonometry of a point taken once, so batches don't redo it for every segment
+    struct PreparedCoordinates {
+        double sin_lat = 0;
+        double cos_lat = 0;
+        double sin_lng = 0;
+        double cos_lng = 0;
+    };
+
+    PreparedCoordinates Prepare(Coordinates coordinates);
+
+    // Length of the path through points[0], ..., points[count - 1]: the sum of ComputeDistance
+    // over neighbouring points, four segments at a time on CPUs with AVX2
+    double ComputePathLength(const PreparedCoordinates* points, size_t count);
+
 }  // namespace geo
\ No newline at end of file
@@ -1,83 +1,197 @@
 #include "json.h"
 
+#include <algorithm>
+#include <charconv>
 #include <iterator>
+#include <system_error>
 
 namespace json {
 
     namespace {
         using namespace std::literals;
 
-        Node LoadNode(std::istream& input);
-        Node LoadString(std::istream& input);
+        // A seekable stream (a file, std::cin redirected from one) is read in one go at its known
+        // size. Anything else, a pipe for one, is read in chunks into a growing buffer.
+        std::string ReadAll(std::istream& input) {
+            std::string buffer;
+            const std::streampos begin = input.tellg();
+            if (begin != std::streampos(-1) && input.seekg(0, std::ios::end)) {
+                const std::streampos end = input.tellg();
+                input.seekg(begin);
+                if (end != std::streampos(-1) && end > begin) {
+                    buffer.resize(static_cast<size_t>(end - begin));
+                    input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                    buffer.resize(static_cast<size_t>(input.gcount()));
+                }
+            }
+            input.clear();
 
-        std::string LoadLiteral(std::istream& input) {
-            std::string s;
-            while (std::isalpha(input.peek())) {
-                s.push_back(static_cast<char>(input.get()));
+            // Whatever the size did not cover
+            char chunk[1 << 16];
+            while (input.read(chunk, sizeof(chunk)) || input.gcount() > 0) {
+                buffer.append(chunk, static_cast<size_t>(input.gcount()));
             }
-            return s;
+            return buffer;
+        }
+
+        bool IsSpace(char c) {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+        }
+
+        bool IsDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        bool IsAlpha(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
         }
 
-        Node LoadArray(std::istream& input) {
-            std::vector<Node> result;
+        // Разбирает значение из непрерывного буфера, сообщая о нём handler
+        class Parser {
+        public:
+            Parser(std::string_view input, Handler& handler)
+                : pos_(input.data())
+                , end_(input.data() + input.size())
+                , handler_(handler) {
+            }
 
-            for (char c; input >> c && c != ']';) {
-                if (c != ',') {
-                    input.putback(c);
+            void LoadNode() {
+                char c;
+                if (!NextChar(c)) {
+                    throw ParsingError("Unexpected EOF"s);
+                }
+                switch (c) {
+                case '[':
+                    LoadArray();
+                    break;
+                case '{':
+                    LoadDict();
+                    break;
+                case '"':
+                    handler_.String(LoadString());
+                    break;
+                case 't':
+                    // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
+                    // подсказкой компилятору и человеку, что здесь программист явно задумывал
+                    // разрешить переход к инструкции следующей ветки case, а не случайно забыл
+                    // написать break, return или throw.
+                    // В данном случае, встретив t или f, переходим к попытке парсинга
+                    // литералов true либо false
+                    [[fallthrough]];
+                case 'f':
+                    --pos_;
+                    LoadBool();
+                    break;
+                case 'n':
+                    --pos_;
+                    LoadNull();
+                    break;
+                default:
+                    --pos_;
+                    LoadNumber();
+                    break;
                 }
-                result.push_back(LoadNode(input));
             }
-            if (!input) {
-                throw ParsingError("Array parsing error"s);
+
+        private:
+            const char* pos_;
+            const char* end_;
+            Handler& handler_;
+
+            // Пропускает пробельные символы и считывает следующий символ, как input >> c
+            bool NextChar(char& c) {
+                while (pos_ != end_ && IsSpace(*pos_)) {
+                    ++pos_;
+                }
+                if (pos_ == end_) {
+                    return false;
+                }
+                c = *pos_++;
+                return true;
+            }
+
+            std::string_view LoadLiteral() {
+                const char* begin = pos_;
+                while (pos_ != end_ && IsAlpha(*pos_)) {
+                    ++pos_;
+                }
+                return { begin, static_cast<size_t>(pos_ - begin) };
             }
-            return Node(std::move(result));
-        }
 
-        Node LoadDict(std::istream& input) {
-            Dict dict;
+            void LoadArray() {
+                handler_.StartArray();
+                char c;
+                bool closed = false;
+                while (NextChar(c)) {
+                    if (c == ']') {
+                        closed = true;
+                        break;
+                    }
+                    if (c != ',') {
+                        --pos_;
+                    }
+                    LoadNode();
+                }
+                if (!closed) {
+                    throw ParsingError("Array parsing error"s);
+                }
+                handler_.EndArray();
+            }
 
-            for (char c; input >> c && c != '}';) {
-                if (c == '"') {
-                    std::string key = LoadString(input).AsString();
-                    if (input >> c && c == ':') {
-                        if (dict.find(key) != dict.end()) {
-                            throw ParsingError("Duplicate key '"s + key + "' have been found");
+            void LoadDict() {
+                handler_.StartDict();
+                char c;
+                bool closed = false;
+                while (NextChar(c)) {
+                    if (c == '}') {
+                        closed = true;
+                        break;
+                    }
+                    if (c == '"') {
+                        std::string key = LoadString();
+                        if (NextChar(c) && c == ':') {
+                            handler_.Key(std::move(key));
+                            LoadNode();
+                        }
+                        else {
+                            throw ParsingError(": is expected but '"s + c + "' has been found"s);
                         }
-                        dict.emplace(std::move(key), LoadNode(input));
                     }
-                    else {
-                        throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                    else if (c != ',') {
+                        throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
                     }
                 }
-                else if (c != ',') {
-                    throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+                if (!closed) {
+                    throw ParsingError("Dictionary parsing error"s);
                 }
+                handler_.EndDict();
             }
-            if (!input) {
-                throw ParsingError("Dictionary parsing error"s);
-            }
-            return Node(std::move(dict));
-        }
 
-        Node LoadString(std::istream& input) {
-            auto it = std::istreambuf_iterator<char>(input);
-            auto end = std::istreambuf_iterator<char>();
-            std::string s;
-            while (true) {
-                if (it == end) {
-                    throw ParsingError("String parsing error");
-                }
-                const char ch = *it;
-                if (ch == '"') {
-                    ++it;
-                    break;
-                }
-                else if (ch == '\\') {
-                    ++it;
-                    if (it == end) {
+            std::string LoadString() {
+                std::string s;
+                while (true) {
+                    // Участок без спецсимволов копируется целиком
+                    const char* run = pos_;
+                    while (pos_ != end_ && *pos_ != '"' && *pos_ != '\\' && *pos_ != '\n' && *pos_ != '\r') {
+                        ++pos_;
+                    }
+                    s.append(run, pos_);
+
+                    if (pos_ == end_) {
                         throw ParsingError("String parsing error");
                     }
-                    const char escaped_char = *(it);
+                    const char ch = *pos_++;
+                    if (ch == '"') {
+                        break;
+                    }
+                    if (ch == '\n' || ch == '\r') {
+                        throw ParsingError("Unexpected end of line"s);
+                    }
+
+                    if (pos_ == end_) {
+                        throw ParsingError("String parsing error");
+                    }
+                    const char escaped_char = *pos_++;
                     switch (escaped_char) {
                     case 'n':
                         s.push_back('\n');
@@ -98,189 +212,194 @@ namespace json {
                         throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
                     }
                 }
-                else if (ch == '\n' || ch == '\r') {
-                    throw ParsingError("Unexpected end of line"s);
+                return s;
+            }
+
+            void LoadBool() {
+                const auto s = LoadLiteral();
+                if (s == "true"sv) {
+                    handler_.Bool(true);
+                }
+                else if (s == "false"sv) {
+                    handler_.Bool(false);
                 }
                 else {
-                    s.push_back(ch);
+                    throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
                 }
-                ++it;
             }
 
-            return Node(std::move(s));
-        }
-
-        Node LoadBool(std::istream& input) {
-            const auto s = LoadLiteral(input);
-            if (s == "true"sv) {
-                return Node{ true };
-            }
-            else if (s == "false"sv) {
-                return Node{ false };
-            }
-            else {
-                throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+            void LoadNull() {
+                if (auto literal = LoadLiteral(); literal == "null"sv) {
+                    handler_.Null();
+                }
+                else {
+                    throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
+                }
             }
-        }
 
-        Node LoadNull(std::istream& input) {
-            if (auto literal = LoadLiteral(input); literal == "null"sv) {
-                return Node{ nullptr };
-            }
-            else {
-                throw ParsingError("Failed to parse '"s + literal + "' as null"s);
-            }
-        }
+            void LoadNumber() {
+                const char* begin = pos_;
 
-        Node LoadNumber(std::istream& input) {
-            std::string parsed_num;
+                // Считывает одну или более цифр
+                auto read_digits = [this] {
+                    if (pos_ == end_ || !IsDigit(*pos_)) {
+                        throw ParsingError("A digit is expected"s);
+                    }
+                    while (pos_ != end_ && IsDigit(*pos_)) {
+                        ++pos_;
+                    }
+                    };
 
-            // Считывает в parsed_num очередной символ из input
-            auto read_char = [&parsed_num, &input] {
-                parsed_num += static_cast<char>(input.get());
-                if (!input) {
-                    throw ParsingError("Failed to read number from stream"s);
+                if (pos_ != end_ && *pos_ == '-') {
+                    ++pos_;
                 }
-                };
-
-            // Считывает одну или более цифр в parsed_num из input
-            auto read_digits = [&input, read_char] {
-                if (!std::isdigit(input.peek())) {
-                    throw ParsingError("A digit is expected"s);
+                // Парсим целую часть числа
+                if (pos_ != end_ && *pos_ == '0') {
+                    ++pos_;
+                    // После 0 в JSON не могут идти другие цифры
                 }
-                while (std::isdigit(input.peek())) {
-                    read_char();
+                else {
+                    read_digits();
                 }
-                };
 
-            if (input.peek() == '-') {
-                read_char();
-            }
-            // Парсим целую часть числа
-            if (input.peek() == '0') {
-                read_char();
-                // После 0 в JSON не могут идти другие цифры
-            }
-            else {
-                read_digits();
-            }
-
-            bool is_int = true;
-            // Парсим дробную часть числа
-            if (input.peek() == '.') {
-                read_char();
-                read_digits();
-                is_int = false;
-            }
+                bool is_int = true;
+                // Парсим дробную часть числа
+                if (pos_ != end_ && *pos_ == '.') {
+                    ++pos_;
+                    read_digits();
+                    is_int = false;
+                }
 
-            // Парсим экспоненциальную часть числа
-            if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-                read_char();
-                if (ch = input.peek(); ch == '+' || ch == '-') {
-                    read_char();
+                // Парсим экспоненциальную часть числа
+                if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+                    ++pos_;
+                    if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-')) {
+                        ++pos_;
+                    }
+                    read_digits();
+                    is_int = false;
                 }
-                read_digits();
-                is_int = false;
-            }
 
-            try {
                 if (is_int) {
-                    // Сначала пробуем преобразовать строку в int
-                    try {
-                        return std::stoi(parsed_num);
-                    }
-                    catch (...) {
-                        // В случае неудачи, например, при переполнении
-                        // код ниже попробует преобразовать строку в double
+                    // Сначала пробуем преобразовать число в int, при переполнении - в double
+                    int value = 0;
+                    if (auto [ptr, ec] = std::from_chars(begin, pos_, value); ec == std::errc()) {
+                        handler_.Int(value);
+                        return;
                     }
                 }
-                return std::stod(parsed_num);
-            }
-            catch (...) {
-                throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
-            }
-        }
 
-        Node LoadNode(std::istream& input) {
-            char c;
-            if (!(input >> c)) {
-                throw ParsingError("Unexpected EOF"s);
-            }
-            switch (c) {
-            case '[':
-                return LoadArray(input);
-            case '{':
-                return LoadDict(input);
-            case '"':
-                return LoadString(input);
-            case 't':
-                // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
-                // подсказкой компилятору и человеку, что здесь программист явно задумывал
-                // разрешить переход к инструкции следующей ветки case, а не случайно забыл
-                // написать break, return или throw.
-                // В данном случае, встретив t или f, переходим к попытке парсинга
-                // литералов true либо false
-                [[fallthrough]];
-            case 'f':
-                input.putback(c);
-                return LoadBool(input);
-            case 'n':
-                input.putback(c);
-                return LoadNull(input);
-            default:
-                input.putback(c);
-                return LoadNumber(input);
+                double value = 0;
+                if (auto [ptr, ec] = std::from_chars(begin, pos_, value); ec != std::errc() || ptr != pos_) {
+                    throw ParsingError("Failed to convert "s + std::string(begin, pos_) + " to number"s);
+                }
+                handler_.Double(value);
             }
-        }
+        };
 
         struct PrintContext {
-            std::ostream& out;
+            OutputBuffer& out;
+            Format format = Format::PRETTY;
             int indent_step = 4;
             int indent = 0;
 
             void PrintIndent() const {
-                for (int i = 0; i < indent; ++i) {
-                    out.put(' ');
+                if (format == Format::PRETTY) {
+                    out.Fill(' ', static_cast<size_t>(indent));
                 }
             }
 
             PrintContext Indented() const {
-                return { out, indent_step, indent_step + indent };
+                return { out, format, indent_step, indent_step + indent };
+            }
+
+            // Открывающая скобка, разделитель элементов и закрывающая скобка контейнера
+            void PrintOpen(char bracket) const {
+                out.Put(bracket);
+                if (format == Format::PRETTY) {
+                    out.Put('\n');
+                }
+            }
+
+            void PrintSeparator() const {
+                out.Put(',');
+                if (format == Format::PRETTY) {
+                    out.Put('\n');
+                }
+            }
+
+            void PrintClose(char bracket) const {
+                if (format == Format::PRETTY) {
+                    out.Put('\n');
+                    PrintIndent();
+                }
+                out.Put(bracket);
+            }
+
+            void PrintKeySeparator() const {
+                out.Write(format == Format::PRETTY ? ": "sv : ":"sv);
+            }
+
+            void PrintNumber(int value) const {
+                char buffer[16];
+                auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+                out.Write({ buffer, static_cast<size_t>(ptr - buffer) });
+            }
+
+            // В обычном режиме, как и ostream по умолчанию, выводятся 6 значащих цифр,
+            // в компактном - кратчайшая запись, из которой число восстанавливается точно
+            void PrintNumber(double value) const {
+                char buffer[32];
+                auto [ptr, ec] = format == Format::PRETTY
+                    ? std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, 6)
+                    : std::to_chars(buffer, buffer + sizeof(buffer), value);
+                out.Write({ buffer, static_cast<size_t>(ptr - buffer) });
             }
         };
 
+        PrintContext MakeContext(OutputBuffer& out, Format format, size_t depth) {
+            return PrintContext{ out, format, 4, static_cast<int>(depth) * 4 };
+        }
+
         void PrintNode(const Node& value, const PrintContext& ctx);
 
         template <typename Value>
         void PrintValue(const Value& value, const PrintContext& ctx) {
-            ctx.out << value;
+            ctx.PrintNumber(value);
         }
 
-        void PrintString(const std::string& value, std::ostream& out) {
-            out.put('"');
-            for (const char c : value) {
-                switch (c) {
+        void PrintString(std::string_view value, OutputBuffer& out) {
+            out.Put('"');
+            size_t run_begin = 0;
+            for (size_t i = 0; i < value.size(); ++i) {
+                std::string_view escaped;
+                switch (value[i]) {
                 case '\r':
-                    out << "\\r"sv;
+                    escaped = "\\r"sv;
                     break;
                 case '\n':
-                    out << "\\n"sv;
+                    escaped = "\\n"sv;
                     break;
                 case '\t':
-                    out << "\\t"sv;
+                    escaped = "\\t"sv;
                     break;
                 case '"':
                     // Символы " и \ выводятся как \" или \\, соответственно
-                    [[fallthrough]];
+                    escaped = "\\\""sv;
+                    break;
                 case '\\':
-                    out.put('\\');
-                    [[fallthrough]];
-                default:
-                    out.put(c);
+                    escaped = "\\\\"sv;
                     break;
+                default:
+                    continue;
                 }
+                // Участок без спецсимволов выводится целиком
+                out.Write(value.substr(run_begin, i - run_begin));
+                out.Write(escaped);
+                run_begin = i + 1;
             }
-            out.put('"');
+            out.Write(value.substr(run_begin));
+            out.Put('"');
         }
 
         template <>
@@ -290,7 +409,7 @@ namespace json {
 
         template <>
         void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& ctx) {
-            ctx.out << "null"sv;
+            ctx.out.Write("null"sv);
         }
 
         // В специализации шаблона PrintValue для типа bool параметр value передаётся
@@ -299,13 +418,12 @@ namespace json {
         // void PrintValue(bool value, const PrintContext& ctx);
         template <>
         void PrintValue<bool>(const bool& value, const PrintContext& ctx) {
-            ctx.out << (value ? "true"sv : "false"sv);
+            ctx.out.Write(value ? "true"sv : "false"sv);
         }
 
         template <>
         void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
-            std::ostream& out = ctx.out;
-            out << "[\n"sv;
+            ctx.PrintOpen('[');
             bool first = true;
             auto inner_ctx = ctx.Indented();
             for (const Node& node : nodes) {
@@ -313,20 +431,17 @@ namespace json {
                     first = false;
                 }
                 else {
-                    out << ",\n"sv;
+                    ctx.PrintSeparator();
                 }
                 inner_ctx.PrintIndent();
                 PrintNode(node, inner_ctx);
             }
-            out.put('\n');
-            ctx.PrintIndent();
-            out.put(']');
+            ctx.PrintClose(']');
         }
 
         template <>
         void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
-            std::ostream& out = ctx.out;
-            out << "{\n"sv;
+            ctx.PrintOpen('{');
             bool first = true;
             auto inner_ctx = ctx.Indented();
             for (const auto& [key, node] : nodes) {
@@ -334,16 +449,14 @@ namespace json {
                     first = false;
                 }
                 else {
-                    out << ",\n"sv;
+                    ctx.PrintSeparator();
                 }
                 inner_ctx.PrintIndent();
                 PrintString(key, ctx.out);
-                out << ": "sv;
+                ctx.PrintKeySeparator();
                 PrintNode(node, inner_ctx);
             }
-            out.put('\n');
-            ctx.PrintIndent();
-            out.put('}');
+            ctx.PrintClose('}');
         }
 
         void PrintNode(const Node& node, const PrintContext& ctx) {
@@ -356,12 +469,306 @@ namespace json {
 
     }  // namespace
 
-    Document Load(std::istream& input) {
-        return Document{ LoadNode(input) };
+    NodeBuilder::NodeBuilder(std::pmr::memory_resource* resource)
+        : resource_(resource) {
     }
 
-    void Print(const Document& doc, std::ostream& output) {
-        PrintNode(doc.GetRoot(), PrintContext{ output });
+    void NodeBuilder::StartDict() {
+        frames_.push_back({ true, values_.size(), std::move(key_) });
+    }
+
+    void NodeBuilder::EndDict() {
+        Frame frame = std::move(frames_.back());
+        frames_.pop_back();
+
+        const auto items_begin = values_.begin() + frame.begin;
+        std::sort(items_begin, values_.end(), [](const Dict::value_type& lhs, const Dict::value_type& rhs) {
+            return lhs.first < rhs.first;
+            });
+        Dict dict(resource_);
+        dict.reserve(values_.end() - items_begin);
+        for (auto it = items_begin; it != values_.end(); ++it) {
+            // Sorted keys always go to the back, so equal keys are neighbours
+            if (!dict.empty() && std::prev(dict.end())->first == it->first) {
+                throw ParsingError("Duplicate key '"s + it->first + "' have been found");
+            }
+            dict.emplace(std::move(it->first), std::move(it->second));
+        }
+        values_.erase(items_begin, values_.end());
+
+        key_ = std::move(frame.key);
+        AddValue(std::move(dict));
+    }
+
+    void NodeBuilder::StartArray() {
+        frames_.push_back({ false, values_.size(), std::move(key_) });
+    }
+
+    void NodeBuilder::EndArray() {
+        Frame frame = std::move(frames_.back());
+        frames_.pop_back();
+
+        const auto items_begin = values_.begin() + frame.begin;
+        Array array(resource_);
+        array.reserve(values_.end() - items_begin);
+        for (auto it = items_begin; it != values_.end(); ++it) {
+            array.push_back(std::move(it->second));
+        }
+        values_.erase(items_begin, values_.end());
+
+        key_ = std::move(frame.key);
+        AddValue(std::move(array));
+    }
+
+    void NodeBuilder::Key(std::string key) {
+        key_ = std::move(key);
+    }
+
+    void NodeBuilder::String(std::string value) {
+        AddValue(std::move(value));
+    }
+
+    void NodeBuilder::Int(int value) {
+        AddValue(value);
+    }
+
+    void NodeBuilder::Double(double value) {
+        AddValue(value);
+    }
+
+    void NodeBuilder::Bool(bool value) {
+        AddValue(value);
+    }
+
+    void NodeBuilder::Null() {
+        AddValue(nullptr);
+    }
+
+    bool NodeBuilder::IsComplete() const {
+        return has_root_ && frames_.empty();
+    }
+
+    Node NodeBuilder::Extract() {
+        has_root_ = false;
+        Node result = std::move(root_);
+        // Switching the alternative drops the moved-from container together with its allocator
+        root_ = Node();
+        return result;
+    }
+
+    void NodeBuilder::AddValue(Node value) {
+        if (frames_.empty()) {
+            root_ = std::move(value);
+            has_root_ = true;
+        }
+        else if (frames_.back().is_dict) {
+            values_.emplace_back(std::move(key_), std::move(value));
+        }
+        else {
+            values_.emplace_back(std::string(), std::move(value));
+        }
+    }
+
+    void Parse(std::string_view input, Handler& handler) {
+        Parser(input, handler).LoadNode();
+    }
+
+    void Parse(std::istream& input, Handler& handler) {
+        Parse(std::string_view(ReadAll(input)), handler);
+    }
+
+    Document Load(std::string_view input, Allocation allocation) {
+        if (allocation == Allocation::HEAP) {
+            NodeBuilder builder;
+            Parse(input, builder);
+            return Document{ builder.Extract() };
+        }
+
+        // The tree usually takes about as much memory as its text
+        auto arena = std::make_unique<Arena>(std::max<size_t>(input.size(), 1024));
+        NodeBuilder builder(arena.get());
+        Parse(input, builder);
+        return Document{ builder.Extract(), std::move(arena) };
+    }
+
+    Document Load(std::istream& input, Allocation allocation) {
+        return Load(std::string_view(ReadAll(input)), allocation);
+    }
+
+    OutputBuffer::OutputBuffer(std::ostream& output)
+        : output_(output) {
+        buffer_.reserve(CAPACITY);
+    }
+
+    OutputBuffer::~OutputBuffer() {
+        Flush();
+    }
+
+    void OutputBuffer::Put(char c) {
+        if (buffer_.size() == CAPACITY) {
+            Flush();
+        }
+        buffer_.push_back(c);
+    }
+
+    void OutputBuffer::Write(std::string_view text) {
+        if (buffer_.size() + text.size() > CAPACITY) {
+            Flush();
+            if (text.size() > CAPACITY) {
+                output_.write(text.data(), static_cast<std::streamsize>(text.size()));
+                return;
+            }
+        }
+        buffer_.append(text);
+    }
+
+    void OutputBuffer::Fill(char c, size_t count) {
+        if (buffer_.size() + count > CAPACITY) {
+            Flush();
+        }
+        buffer_.append(count, c);
+    }
+
+    void OutputBuffer::Flush() {
+        output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+
+    void Print(const Document& doc, std::ostream& output, Format format) {
+        OutputBuffer buffer(output);
+        PrintNode(doc.GetRoot(), PrintContext{ buffer, format });
+    }
+
+    Writer::Writer(std::ostream& output, Format format)
+        : output_(output)
+        , format_(format) {
+    }
+
+    Writer::Writer(std::ostream& output, Format format, size_t depth)
+        : output_(output)
+        , format_(format)
+        , depth_(depth) {
+    }
+
+    Writer& Writer::StartDict() {
+        BeginValue();
+        MakeContext(output_, format_, depth_ + scopes_.size()).PrintOpen('{');
+        scopes_.push_back({ true, true });
+        return *this;
+    }
+
+    Writer& Writer::EndDict() {
+        EndScope(true);
+        MakeContext(output_, format_, depth_ + scopes_.size()).PrintClose('}');
+        return *this;
+    }
+
+    Writer& Writer::StartArray() {
+        BeginValue();
+        MakeContext(output_, format_, depth_ + scopes_.size()).PrintOpen('[');
+        scopes_.push_back({ false, true });
+        return *this;
+    }
+
+    Writer& Writer::EndArray() {
+        EndScope(false);
+        MakeContext(output_, format_, depth_ + scopes_.size()).PrintClose(']');
+        return *this;
+    }
+
+    Writer& Writer::Key(std::string_view key) {
+        if (scopes_.empty() || !scopes_.back().is_dict || has_key_) {
+            throw std::logic_error("Key() outside a dict"s);
+        }
+        BeginItem();
+        PrintString(key, output_);
+        MakeContext(output_, format_, depth_ + scopes_.size()).PrintKeySeparator();
+        has_key_ = true;
+        return *this;
+    }
+
+    Writer& Writer::Value(std::nullptr_t) {
+        BeginValue();
+        PrintValue(nullptr, MakeContext(output_, format_, depth_ + scopes_.size()));
+        return *this;
+    }
+
+    Writer& Writer::Value(bool value) {
+        BeginValue();
+        PrintValue(value, MakeContext(output_, format_, depth_ + scopes_.size()));
+        return *this;
+    }
+
+    Writer& Writer::Value(int value) {
+        BeginValue();
+        MakeContext(output_, format_, depth_ + scopes_.size()).PrintNumber(value);
+        return *this;
+    }
+
+    Writer& Writer::Value(double value) {
+        BeginValue();
+        MakeContext(output_, format_, depth_ + scopes_.size()).PrintNumber(value);
+        return *this;
+    }
+
+    Writer& Writer::Value(std::string_view value) {
+        BeginValue();
+        PrintString(value, output_);
+        return *this;
+    }
+
+    Writer& Writer::Value(const std::string& value) {
+        return Value(std::string_view(value));
+    }
+
+    Writer& Writer::Value(const char* value) {
+        return Value(std::string_view(value));
+    }
+
+    Writer& Writer::Value(const Node& value) {
+        BeginValue();
+        PrintNode(value, MakeContext(output_, format_, depth_ + scopes_.size()));
+        return *this;
+    }
+
+    Writer& Writer::RawValue(std::string_view json) {
+        BeginValue();
+        output_.Write(json);
+        return *this;
+    }
+
+    void Writer::Flush() {
+        output_.Flush();
+    }
+
+    void Writer::BeginValue() {
+        if (scopes_.empty()) {
+            return;
+        }
+        if (scopes_.back().is_dict) {
+            if (!has_key_) {
+                throw std::logic_error("Value() in a dict without a key"s);
+            }
+            has_key_ = false;
+            return;
+        }
+        BeginItem();
+    }
+
+    void Writer::BeginItem() {
+        Scope& scope = scopes_.back();
+        if (!scope.is_empty) {
+            MakeContext(output_, format_, depth_ + scopes_.size() - 1).PrintSeparator();
+        }
+        scope.is_empty = false;
+        MakeContext(output_, format_, depth_ + scopes_.size()).PrintIndent();
+    }
+
+    void Writer::EndScope(bool is_dict) {
+        if (scopes_.empty() || scopes_.back().is_dict != is_dict || has_key_) {
+            throw std::logic_error(is_dict ? "EndDict() outside a dict"s : "EndArray() outside an array"s);
+        }
+        scopes_.pop_back();
     }
 
 }  // namespace json
\ No newline at end of file
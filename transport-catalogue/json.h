@@ -1,16 +1,58 @@
 #pragma once
 
+#include <algorithm>
+#include <initializer_list>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
 #include <vector>
 
 namespace json {
 
     class Node;
-    using Dict = std::map<std::string, Node>;
-    using Array = std::vector<Node>;
+    // Containers take a memory resource so that a whole document can live in one arena
+    using Array = std::pmr::vector<Node>;
+    using Arena = std::pmr::monotonic_buffer_resource;
+
+    // Key/value pairs kept sorted by key in one contiguous vector: lookups are a binary search
+    // without pointer chasing, and iteration goes in key order like std::map
+    class Dict {
+    public:
+        using value_type = std::pair<std::string, Node>;
+        using Storage = std::pmr::vector<value_type>;
+        using iterator = Storage::iterator;
+        using const_iterator = Storage::const_iterator;
+
+        Dict() = default;
+        explicit Dict(std::pmr::memory_resource* resource);
+        Dict(std::initializer_list<value_type> items);
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        size_t size() const;
+        bool empty() const;
+        void reserve(size_t size);
+
+        const_iterator find(std::string_view key) const;
+        size_t count(std::string_view key) const;
+        // Throws std::out_of_range if there is no such key
+        const Node& at(std::string_view key) const;
+
+        Node& operator[](std::string key);
+        std::pair<iterator, bool> emplace(std::string key, Node value);
+
+        bool operator==(const Dict& rhs) const;
+
+    private:
+        Storage items_;
+
+        iterator LowerBound(std::string_view key);
+        const_iterator LowerBound(std::string_view key) const;
+    };
 
     class ParsingError : public std::runtime_error {
     public:
@@ -114,6 +156,82 @@ namespace json {
         }
     };
 
+    inline Dict::Dict(std::pmr::memory_resource* resource)
+        : items_(resource) {
+    }
+
+    inline Dict::Dict(std::initializer_list<value_type> items) {
+        for (const auto& [key, value] : items) {
+            emplace(key, value);
+        }
+    }
+
+    inline Dict::const_iterator Dict::begin() const {
+        return items_.begin();
+    }
+
+    inline Dict::const_iterator Dict::end() const {
+        return items_.end();
+    }
+
+    inline size_t Dict::size() const {
+        return items_.size();
+    }
+
+    inline bool Dict::empty() const {
+        return items_.empty();
+    }
+
+    inline void Dict::reserve(size_t size) {
+        items_.reserve(size);
+    }
+
+    inline Dict::const_iterator Dict::find(std::string_view key) const {
+        auto it = LowerBound(key);
+        return it != items_.end() && it->first == key ? it : items_.end();
+    }
+
+    inline size_t Dict::count(std::string_view key) const {
+        return find(key) != items_.end() ? 1 : 0;
+    }
+
+    inline const Node& Dict::at(std::string_view key) const {
+        using namespace std::literals;
+        auto it = find(key);
+        if (it == items_.end()) {
+            throw std::out_of_range("No key '"s + std::string(key) + "' in dict"s);
+        }
+        return it->second;
+    }
+
+    inline Node& Dict::operator[](std::string key) {
+        return emplace(std::move(key), Node{}).first->second;
+    }
+
+    inline std::pair<Dict::iterator, bool> Dict::emplace(std::string key, Node value) {
+        auto it = LowerBound(key);
+        if (it != items_.end() && it->first == key) {
+            return { it, false };
+        }
+        return { items_.emplace(it, std::move(key), std::move(value)), true };
+    }
+
+    inline bool Dict::operator==(const Dict& rhs) const {
+        return items_ == rhs.items_;
+    }
+
+    inline Dict::iterator Dict::LowerBound(std::string_view key) {
+        return std::lower_bound(items_.begin(), items_.end(), key, [](const value_type& item, std::string_view key) {
+            return item.first < key;
+            });
+    }
+
+    inline Dict::const_iterator Dict::LowerBound(std::string_view key) const {
+        return std::lower_bound(items_.begin(), items_.end(), key, [](const value_type& item, std::string_view key) {
+            return item.first < key;
+            });
+    }
+
     inline bool operator!=(const Node& lhs, const Node& rhs) {
         return !(lhs == rhs);
     }
@@ -121,15 +239,32 @@ namespace json {
     class Document {
     public:
         explicit Document(Node root)
-            : root_(std::move(root)) {
+            : root_(std::make_unique<Node>(std::move(root))) {
+        }
+
+        // root must have been built with arena, the document keeps it until destruction
+        Document(Node root, std::unique_ptr<Arena> arena)
+            : arena_(std::move(arena))
+            , root_(std::make_unique<Node>(std::move(root))) {
+        }
+
+        Document(Document&& other) = default;
+
+        Document& operator=(Document&& other) noexcept {
+            // The old tree has to go before the arena it was allocated from
+            root_ = std::move(other.root_);
+            arena_ = std::move(other.arena_);
+            return *this;
         }
 
         const Node& GetRoot() const {
-            return root_;
+            return *root_;
         }
 
     private:
-        Node root_;
+        // Declared before root_ so that it outlives the nodes
+        std::unique_ptr<Arena> arena_;
+        std::unique_ptr<Node> root_;
     };
 
     inline bool operator==(const Document& lhs, const Document& rhs) {
@@ -140,8 +275,153 @@ namespace json {
         return !(lhs == rhs);
     }
 
-    Document Load(std::istream& input);
+    // Receives parsing events in document order, see Parse
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+
+        virtual void StartDict() = 0;
+        virtual void EndDict() = 0;
+        virtual void StartArray() = 0;
+        virtual void EndArray() = 0;
+        virtual void Key(std::string key) = 0;
+        virtual void String(std::string value) = 0;
+        virtual void Int(int value) = 0;
+        virtual void Double(double value) = 0;
+        virtual void Bool(bool value) = 0;
+        virtual void Null() = 0;
+    };
+
+    // Handler that assembles the events of one value into a Node
+    class NodeBuilder final : public Handler {
+    public:
+        // Arrays and dicts of the built value allocate from resource
+        explicit NodeBuilder(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+        void StartDict() override;
+        void EndDict() override;
+        void StartArray() override;
+        void EndArray() override;
+        void Key(std::string key) override;
+        void String(std::string value) override;
+        void Int(int value) override;
+        void Double(double value) override;
+        void Bool(bool value) override;
+        void Null() override;
+
+        // True once a whole value has been received
+        bool IsComplete() const;
+        Node Extract();
+
+    private:
+        // An open array or dict, its items are values_ from begin on
+        struct Frame {
+            bool is_dict;
+            size_t begin;
+            // Key of the container itself in its parent dict
+            std::string key;
+        };
+
+        std::pmr::memory_resource* resource_;
+        Node root_;
+        bool has_root_ = false;
+        std::vector<Frame> frames_;
+        // Items of all open containers; a container is allocated at its exact size once it closes
+        std::vector<Dict::value_type> values_;
+        std::string key_;
+
+        void AddValue(Node value);
+    };
+
+    // Parses one value from a contiguous buffer without building a document, reporting it to handler
+    void Parse(std::string_view input, Handler& handler);
+    // Reads the whole stream into a buffer and parses it. A file is read once at its size,
+    // a pipe in chunks, when the growing buffer can briefly take twice the input
+    void Parse(std::istream& input, Handler& handler);
+
+    enum class Allocation {
+        // Every node is allocated on its own
+        HEAP,
+        // Nodes are allocated from an arena owned by the document and released at once
+        ARENA
+    };
+
+    Document Load(std::string_view input, Allocation allocation = Allocation::HEAP);
+    Document Load(std::istream& input, Allocation allocation = Allocation::HEAP);
+
+    enum class Format {
+        // Indented by 4 spaces, doubles with 6 significant digits
+        PRETTY,
+        // No whitespace, doubles in the shortest form that reads back exactly
+        COMPACT
+    };
+
+    // Collects output in a large chunk and hands it to the stream in one write
+    class OutputBuffer {
+    public:
+        explicit OutputBuffer(std::ostream& output);
+        ~OutputBuffer();
+
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+        void Put(char c);
+        void Write(std::string_view text);
+        void Fill(char c, size_t count);
+        void Flush();
+
+    private:
+        static constexpr size_t CAPACITY = 1 << 16;
+
+        std::ostream& output_;
+        std::string buffer_;
+    };
+
+    void Print(const Document& doc, std::ostream& output, Format format = Format::PRETTY);
+
+    // Writes a document straight to output, in the same layout as Print, without building nodes
+    class Writer {
+    public:
+        explicit Writer(std::ostream& output, Format format = Format::PRETTY);
+        // Writes a value that will sit depth containers deep in an enclosing document
+        Writer(std::ostream& output, Format format, size_t depth);
+
+        Writer& StartDict();
+        Writer& EndDict();
+        Writer& StartArray();
+        Writer& EndArray();
+        Writer& Key(std::string_view key);
+
+        Writer& Value(std::nullptr_t);
+        Writer& Value(bool value);
+        Writer& Value(int value);
+        Writer& Value(double value);
+        Writer& Value(std::string_view value);
+        Writer& Value(const std::string& value);
+        Writer& Value(const char* value);
+        Writer& Value(const Node& value);
+        // Inserts an already serialized value as is
+        Writer& RawValue(std::string_view json);
 
-    void Print(const Document& doc, std::ostream& output);
+        // Hands the buffered output to the stream, also done on destruction
+        void Flush();
+
+    private:
+        struct Scope {
+            bool is_dict;
+            bool is_empty;
+        };
+
+        OutputBuffer output_;
+        Format format_;
+        size_t depth_ = 0;
+        std::vector<Scope> scopes_;
+        bool has_key_ = false;
+
+        // Separator and indent before a value in the current scope
+        void BeginValue();
+        void BeginItem();
+        void EndScope(bool is_dict);
+    };
 
 }  // namespace json
\ No newline at end of file
@@ -40,8 +40,239 @@ namespace {
         
     }
 
+    graph::RouterMode ParseRouterMode(const std::string& mode) {
+        if (mode == "eager") {
+            return graph::RouterMode::EAGER;
+        }
+        if (mode == "on_demand") {
+            return graph::RouterMode::ON_DEMAND;
+        }
+        if (mode == "contraction_hierarchies") {
+            return graph::RouterMode::CONTRACTION_HIERARCHIES;
+        }
+        throw std::invalid_argument("Unknown router_mode: " + mode);
+    }
+
+    GraphModel ParseGraphModel(const std::string& model) {
+        if (model == "direct") {
+            return GraphModel::DIRECT;
+        }
+        if (model == "transfer") {
+            return GraphModel::TRANSFER;
+        }
+        throw std::invalid_argument("Unknown graph_model: " + model);
+    }
+
+    size_t ParseCount(const json::Node& node, const std::string& key) {
+        const int count = node.AsInt();
+        if (count < 0) {
+            throw std::invalid_argument("Negative " + key + ": " + std::to_string(count));
+        }
+        return static_cast<size_t>(count);
+    }
+
+    json::Format ParseFormat(const std::string& format) {
+        if (format == "pretty") {
+            return json::Format::PRETTY;
+        }
+        if (format == "compact") {
+            return json::Format::COMPACT;
+        }
+        throw std::invalid_argument("Unknown output format: " + format);
+    }
+
 } // namespace
 
+class JsonReader::StreamHandler final : public json::Handler {
+public:
+    StreamHandler(const JsonReader& reader, TransportCatalogue& catalogue)
+        : reader_(reader)
+        , catalogue_(catalogue)
+        , arena_(std::make_unique<json::Arena>())
+        , sections_(arena_.get())
+        , section_builder_(arena_.get())
+    {}
+
+    void StartDict() override {
+        if (state_ == State::ROOT) {
+            state_ = State::SECTIONS;
+            return;
+        }
+        OnValueEvent([](json::NodeBuilder& builder) { builder.StartDict(); });
+    }
+
+    void EndDict() override {
+        if (state_ == State::SECTIONS) {
+            state_ = State::DONE;
+            return;
+        }
+        OnValueEvent([](json::NodeBuilder& builder) { builder.EndDict(); });
+    }
+
+    void StartArray() override {
+        if (state_ == State::BASE_REQUESTS_VALUE) {
+            state_ = State::BASE_REQUESTS;
+            return;
+        }
+        OnValueEvent([](json::NodeBuilder& builder) { builder.StartArray(); });
+    }
+
+    void EndArray() override {
+        if (state_ == State::BASE_REQUESTS) {
+            state_ = State::SECTIONS;
+            return;
+        }
+        OnValueEvent([](json::NodeBuilder& builder) { builder.EndArray(); });
+    }
+
+    void Key(std::string key) override {
+        if (state_ != State::SECTIONS) {
+            OnValueEvent([&key](json::NodeBuilder& builder) { builder.Key(std::move(key)); });
+            return;
+        }
+        if (sections_.count(key) || (key == "base_requests" && has_base_requests_)) {
+            throw json::ParsingError("Duplicate key '" + key + "' have been found");
+        }
+        if (key == "base_requests") {
+            has_base_requests_ = true;
+            state_ = State::BASE_REQUESTS_VALUE;
+        }
+        else {
+            section_key_ = std::move(key);
+            state_ = State::SECTION_VALUE;
+        }
+    }
+
+    void String(std::string value) override {
+        OnValueEvent([&value](json::NodeBuilder& builder) { builder.String(std::move(value)); });
+    }
+
+    void Int(int value) override {
+        OnValueEvent([value](json::NodeBuilder& builder) { builder.Int(value); });
+    }
+
+    void Double(double value) override {
+        OnValueEvent([value](json::NodeBuilder& builder) { builder.Double(value); });
+    }
+
+    void Bool(bool value) override {
+        OnValueEvent([value](json::NodeBuilder& builder) { builder.Bool(value); });
+    }
+
+    void Null() override {
+        OnValueEvent([](json::NodeBuilder& builder) { builder.Null(); });
+    }
+
+    // Distances and buses may refer to stops listed after them, so they are added at the end
+    json::Document Finish() {
+        for (const auto& [from, to, distance] : pending_distances_) {
+            catalogue_.SetDistance({ from, catalogue_.FindStop(to) }, distance);
+        }
+        for (const auto& bus : pending_buses_) {
+            std::vector<const Stop*> stops;
+            stops.reserve(bus.stops.size());
+            for (const auto& stop : bus.stops) {
+                stops.push_back(catalogue_.FindStop(stop));
+            }
+            catalogue_.AddRoute(bus.number, stops, bus.is_roundtrip);
+        }
+        pending_distances_.clear();
+        pending_buses_.clear();
+        return json::Document(json::Node(std::move(sections_)), std::move(arena_));
+    }
+
+private:
+    enum class State {
+        ROOT,
+        SECTIONS,
+        SECTION_VALUE,
+        BASE_REQUESTS_VALUE,
+        BASE_REQUESTS,
+        BASE_REQUEST,
+        DONE
+    };
+
+    struct PendingDistance {
+        const Stop* from;
+        std::string to;
+        int distance;
+    };
+
+    struct PendingBus {
+        std::string number;
+        std::vector<std::string> stops;
+        bool is_roundtrip;
+    };
+
+    const JsonReader& reader_;
+    TransportCatalogue& catalogue_;
+    State state_ = State::ROOT;
+    bool has_base_requests_ = false;
+    std::string section_key_;
+    // Sections are kept for the whole run and go to the arena, base requests are dropped
+    // one by one and stay on the heap
+    std::unique_ptr<json::Arena> arena_;
+    json::Dict sections_;
+    json::NodeBuilder section_builder_;
+    json::NodeBuilder request_builder_;
+    std::vector<PendingDistance> pending_distances_;
+    std::vector<PendingBus> pending_buses_;
+
+    template <typename Event>
+    void OnValueEvent(Event event) {
+        if (state_ == State::BASE_REQUESTS) {
+            state_ = State::BASE_REQUEST;
+        }
+        if (state_ != State::SECTION_VALUE && state_ != State::BASE_REQUEST) {
+            throw json::ParsingError("Requests must be a dict with base_requests as an array");
+        }
+
+        json::NodeBuilder& builder = state_ == State::SECTION_VALUE ? section_builder_ : request_builder_;
+        event(builder);
+        if (!builder.IsComplete()) {
+            return;
+        }
+
+        if (state_ == State::SECTION_VALUE) {
+            sections_.emplace(std::move(section_key_), builder.Extract());
+            state_ = State::SECTIONS;
+        }
+        else {
+            AddBaseRequest(builder.Extract().AsDict());
+            state_ = State::BASE_REQUESTS;
+        }
+    }
+
+    void AddBaseRequest(const json::Dict& request_map) {
+        const auto& type = request_map.at("type").AsString();
+        if (type == "Stop") {
+            auto [stop_name, coordinates, stop_distances] = reader_.GetStopData(request_map);
+            catalogue_.AddStop(std::string(stop_name), coordinates);
+            const Stop* from = catalogue_.FindStop(stop_name);
+            for (auto& [to_name, dist] : stop_distances) {
+                pending_distances_.push_back({ from, std::string(to_name), dist });
+            }
+        }
+        else if (type == "Bus") {
+            PendingBus bus;
+            bus.number = request_map.at("name").AsString();
+            for (auto& stop : request_map.at("stops").AsArray()) {
+                bus.stops.push_back(stop.AsString());
+            }
+            bus.is_roundtrip = request_map.at("is_roundtrip").AsBool();
+            pending_buses_.push_back(std::move(bus));
+        }
+    }
+};
+
+JsonReader::JsonReader(std::istream& input, TransportCatalogue& catalogue)
+    : input_(json::Node(nullptr))
+{
+    StreamHandler handler(*this, catalogue);
+    json::Parse(input, handler);
+    input_ = handler.Finish();
+}
+
 const json::Node& JsonReader::GetBaseRequests() const {
     if (!input_.GetRoot().AsDict().count("base_requests")) {
         return dummy_;
@@ -70,8 +301,40 @@ const json::Node& json_reader::JsonReader::GetRouterSettings() const {
     return input_.GetRoot().AsDict().at("routing_settings");
 }
 
+const json::Node& JsonReader::GetSerializationSettings() const {
+    if (!input_.GetRoot().AsDict().count("serialization_settings")) {
+        return dummy_;
+    }
+    return input_.GetRoot().AsDict().at("serialization_settings");
+}
+
+const json::Node& JsonReader::GetOutputSettings() const {
+    if (!input_.GetRoot().AsDict().count("output_settings")) {
+        return dummy_;
+    }
+    return input_.GetRoot().AsDict().at("output_settings");
+}
+
+const json::Node& JsonReader::GetStatSettings() const {
+    if (!input_.GetRoot().AsDict().count("stat_settings")) {
+        return dummy_;
+    }
+    return input_.GetRoot().AsDict().at("stat_settings");
+}
+
+const json::Node& JsonReader::GetServerSettings() const {
+    if (!input_.GetRoot().AsDict().count("server_settings")) {
+        return dummy_;
+    }
+    return input_.GetRoot().AsDict().at("server_settings");
+}
+
 void JsonReader::FillCatalogue(TransportCatalogue& catalogue) {
-    const json::Array& arr = GetBaseRequests().AsArray();
+    auto& request = GetBaseRequests();
+    if (request.IsNull()) {
+        return;
+    }
+    const json::Array& arr = request.AsArray();
     for (auto& request_stops : arr) {
         const auto& request_stops_map = request_stops.AsDict();
         const auto& type = request_stops_map.at("type").AsString();
@@ -131,11 +394,63 @@ RouterSettings json_reader::JsonReader::ParseRouterSettings() const {
     RouterSettings settings;
     settings.bus_wait_time = request_map.at("bus_wait_time").AsDouble();
     settings.bus_velocity = request_map.at("bus_velocity").AsDouble();
+    if (request_map.count("router_mode")) {
+        settings.router_mode = ParseRouterMode(request_map.at("router_mode").AsString());
+    }
+    if (request_map.count("router_threads")) {
+        settings.router_threads = ParseCount(request_map.at("router_threads"), "router_threads");
+    }
+    if (request_map.count("graph_model")) {
+        settings.graph_model = ParseGraphModel(request_map.at("graph_model").AsString());
+    }
+    if (request_map.count("route_cache_size")) {
+        settings.route_cache_size = ParseCount(request_map.at("route_cache_size"), "route_cache_size");
+    }
+
+    return settings;
+}
 
+serialization::SerializationSettings JsonReader::ParseSerializationSettings() const {
+    auto& request = GetSerializationSettings();
+    if (request.IsNull()) {
+        throw std::invalid_argument("serialization_settings are missing");
+    }
+
+    serialization::SerializationSettings settings;
+    settings.file = request.AsDict().at("file").AsString();
+    if (request.AsDict().count("mapped_catalogue_file")) {
+        settings.mapped_catalogue_file = request.AsDict().at("mapped_catalogue_file").AsString();
+    }
     return settings;
 }
 
+json::Format JsonReader::ParseOutputFormat() const {
+    auto& request = GetOutputSettings();
+    if (request.IsNull() || !request.AsDict().count("format")) {
+        return json::Format::PRETTY;
+    }
+    return ParseFormat(request.AsDict().at("format").AsString());
+}
+
+size_t JsonReader::ParseStatThreads() const {
+    auto& request = GetStatSettings();
+    if (request.IsNull() || !request.AsDict().count("threads")) {
+        return 1;
+    }
+    return ParseCount(request.AsDict().at("threads"), "threads");
+}
 
+server::ServerSettings JsonReader::ParseServerSettings() const {
+    auto& request = GetServerSettings();
+    if (request.IsNull()) {
+        throw std::invalid_argument("server_settings are missing");
+    }
+
+    server::ServerSettings settings;
+    settings.socket = request.AsDict().at("socket").AsString();
+    settings.stat_threads = ParseStatThreads();
+    return settings;
+}
 
 JsonReader::StopData JsonReader::GetStopData(const json::Dict& request_map) const {
     std::string_view stop_name = request_map.at("name").AsString();
@@ -4,8 +4,11 @@
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "transport_router.h"
+#include "serialization.h"
+#include "server.h"
 
 #include <iostream>
+#include <map>
 
 namespace json_reader {
 
@@ -15,20 +18,35 @@ namespace json_reader {
         using RouteData = std::tuple<std::string_view, std::vector<const transport_catalogue::Stop*>, bool>;
 
         JsonReader(std::istream& input)
-            : input_(json::Load(input))
+            : input_(json::Load(input, json::Allocation::ARENA))
         {}
+
+        // Fills catalogue straight from the base_requests events while parsing, so their
+        // nodes are never kept; the other sections are loaded as usual
+        JsonReader(std::istream& input, transport_catalogue::TransportCatalogue& catalogue);
         
         const json::Node& GetBaseRequests() const;
         const json::Node& GetStatRequests() const;
         const json::Node& GetRenderSettings() const;
         const json::Node& GetRouterSettings() const;
+        const json::Node& GetSerializationSettings() const;
+        const json::Node& GetOutputSettings() const;
+        const json::Node& GetStatSettings() const;
+        const json::Node& GetServerSettings() const;
 
         void FillCatalogue(transport_catalogue::TransportCatalogue& catalogue);
         void FillRenderSettings(renderer::MapRenderer& map_renderer) const;
         
         transport_router::RouterSettings ParseRouterSettings() const;
+        serialization::SerializationSettings ParseSerializationSettings() const;
+        json::Format ParseOutputFormat() const;
+        // Threads answering stat_requests, 0 means one per core, 1 (the default) answers in sequence
+        size_t ParseStatThreads() const;
+        server::ServerSettings ParseServerSettings() const;
 
     private:
+        class StreamHandler;
+
         json::Document input_;
         json::Node dummy_ = nullptr;
 
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace lru_cache {
+
+    struct CacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t size = 0;
+        size_t capacity = 0;
+    };
+
+    // Bounded map that evicts the least recently used entry. All calls lock one mutex,
+    // so values should be cheap to copy (a shared_ptr to the real data, for instance).
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class LruCache {
+    public:
+        explicit LruCache(size_t capacity)
+            : capacity_(capacity)
+        {
+            index_.reserve(capacity);
+        }
+
+        LruCache(const LruCache&) = delete;
+        LruCache& operator=(const LruCache&) = delete;
+
+        // Marks the entry as the most recently used one
+        std::optional<Value> Find(const Key& key) {
+            std::lock_guard lock(mutex_);
+            const auto it = index_.find(key);
+            if (it == index_.end()) {
+                ++misses_;
+                return std::nullopt;
+            }
+            ++hits_;
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->second;
+        }
+
+        void Insert(const Key& key, Value value) {
+            if (capacity_ == 0) {
+                return;
+            }
+            std::lock_guard lock(mutex_);
+            if (const auto it = index_.find(key); it != index_.end()) {
+                // Another thread got here first with the same answer
+                entries_.splice(entries_.begin(), entries_, it->second);
+                return;
+            }
+            if (entries_.size() == capacity_) {
+                // The evicted node is reused for the new entry
+                index_.erase(entries_.back().first);
+                entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+                entries_.front() = { key, std::move(value) };
+            }
+            else {
+                entries_.emplace_front(key, std::move(value));
+            }
+            index_.emplace(key, entries_.begin());
+        }
+
+        CacheStats GetStats() const {
+            std::lock_guard lock(mutex_);
+            return { hits_, misses_, entries_.size(), capacity_ };
+        }
+
+    private:
+        using Entries = std::list<std::pair<Key, Value>>;
+
+        const size_t capacity_;
+        mutable std::mutex mutex_;
+        // Most recently used first
+        Entries entries_;
+        std::unordered_map<Key, typename Entries::iterator, Hash> index_;
+        uint64_t hits_ = 0;
+        uint64_t misses_ = 0;
+    };
+
+} // namespace lru_cache
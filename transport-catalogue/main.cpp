@@ -1,26 +1,135 @@
+#include <fstream>
 #include <iostream>
+#include <string_view>
 
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "json_reader.h"
 #include "request_handler.h"
+#include "serialization.h"
+#include "mapped_catalogue.h"
+#include "server.h"
 
 using namespace std;
 using namespace transport_catalogue;
 using namespace transport_router;
 
-int main() {
-    json_reader::JsonReader requests(std::cin);
-    
+namespace {
+    void PrintUsage(std::ostream& stream = std::cerr) {
+        stream << "Usage: transport_catalogue [make_base|process_requests|serve]\n"sv;
+    }
+
+    void MakeBase(json_reader::JsonReader& requests, TransportCatalogue& catalogue) {
+        RouterSettings router_settings = requests.ParseRouterSettings();
+        TransportRouter router(catalogue, router_settings);
+
+        renderer::MapRenderer map_renderer;
+        requests.FillRenderSettings(map_renderer);
+
+        const serialization::SerializationSettings settings = requests.ParseSerializationSettings();
+        std::ofstream output(settings.file, std::ios::binary);
+        serialization::SaveBase(output, catalogue, map_renderer, router);
+
+        if (!settings.mapped_catalogue_file.empty()) {
+            std::ofstream mapped_output(settings.mapped_catalogue_file, std::ios::binary);
+            MappedCatalogue::Write(catalogue, mapped_output);
+        }
+    }
+
+    void ProcessRequests(json_reader::JsonReader& requests, TransportCatalogue& catalogue) {
+        const serialization::SerializationSettings settings = requests.ParseSerializationSettings();
+        // Lookups alone are answered from the mapped catalogue without loading the snapshot
+        if (!settings.mapped_catalogue_file.empty()
+            && request_handler::MappedRequestHandler::CanAnswer(requests.GetStatRequests().AsArray())) {
+            MappedCatalogue mapped(settings.mapped_catalogue_file);
+            request_handler::MappedRequestHandler handler(requests, mapped);
+            handler.ProcessRequests();
+            return;
+        }
+
+        TransportRouter router;
+        renderer::MapRenderer map_renderer;
+
+        std::ifstream input(settings.file, std::ios::binary);
+        serialization::LoadBase(input, catalogue, map_renderer, router);
+
+        request_handler::RequestHandler handler(requests, catalogue, router, map_renderer);
+        handler.ProcessRequests();
+    }
+
+    void MakeBaseAndProcessRequests(json_reader::JsonReader& requests, TransportCatalogue& catalogue) {
+        RouterSettings router_settings = requests.ParseRouterSettings();
+        TransportRouter router(catalogue, router_settings);
+
+        renderer::MapRenderer map_renderer;
+        requests.FillRenderSettings(map_renderer);
+
+        request_handler::RequestHandler handler(requests, catalogue, router, map_renderer);
+        handler.ProcessRequests();
+    }
+
+    // Keeps the catalogue, router and map renderer resident and answers stat_requests
+    // batches from clients. Without base_requests the base is loaded from the snapshot,
+    // and with a mapped catalogue only once a batch asks for more than Stop and Bus.
+    void Serve(json_reader::JsonReader& requests, TransportCatalogue& catalogue) {
+        const server::ServerSettings settings = requests.ParseServerSettings();
+        renderer::MapRenderer map_renderer;
+
+        if (catalogue.GetStops().empty()) {
+            TransportRouter router;
+            const serialization::SerializationSettings serialization_settings = requests.ParseSerializationSettings();
+            auto load_base = [&] {
+                std::ifstream input(serialization_settings.file, std::ios::binary);
+                serialization::LoadBase(input, catalogue, map_renderer, router);
+            };
+
+            if (serialization_settings.mapped_catalogue_file.empty()) {
+                load_base();
+                server::Server server(catalogue, router, map_renderer, settings);
+                server.Run();
+                return;
+            }
+            MappedCatalogue mapped(serialization_settings.mapped_catalogue_file);
+            server::Server server(mapped, catalogue, router, map_renderer, load_base, settings);
+            server.Run();
+            return;
+        }
+
+        TransportRouter router(catalogue, requests.ParseRouterSettings());
+        requests.FillRenderSettings(map_renderer);
+
+        server::Server server(catalogue, router, map_renderer, settings);
+        server.Run();
+    }
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc > 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    // base_requests go straight into the catalogue while stdin is parsed
     TransportCatalogue catalogue;
-    requests.FillCatalogue(catalogue);
-    
-    RouterSettings router_settings = requests.ParseRouterSettings();
-    TransportRouter router(catalogue, router_settings);
+    json_reader::JsonReader requests(std::cin, catalogue);
 
-    renderer::MapRenderer map_renderer;
-    requests.FillRenderSettings(map_renderer);
+    if (argc == 1) {
+        MakeBaseAndProcessRequests(requests, catalogue);
+        return 0;
+    }
 
-    request_handler::RequestHandler handler(requests, catalogue, router, map_renderer);
-    handler.ProcessRequests();
-}
\ No newline at end of file
+    const std::string_view mode(argv[1]);
+    if (mode == "make_base"sv) {
+        MakeBase(requests, catalogue);
+    }
+    else if (mode == "process_requests"sv) {
+        ProcessRequests(requests, catalogue);
+    }
+    else if (mode == "serve"sv) {
+        Serve(requests, catalogue);
+    }
+    else {
+        PrintUsage();
+        return 1;
+    }
+}
@@ -1,5 +1,7 @@
 #include "map_renderer.h"
 
+#include <sstream>
+
 namespace renderer {
 
     namespace {
@@ -16,6 +18,10 @@ namespace renderer {
         render_settings_ = settings;
     }
 
+    const RenderSettings& MapRenderer::GetRendererSettings() const {
+        return render_settings_;
+    }
+
     std::vector<svg::Polyline> MapRenderer::GetRouteLines(const Buses& buses, const SphereProjector& sp) const {
         std::vector<svg::Polyline> result;
 
@@ -145,17 +151,25 @@ namespace renderer {
         return result;
     }
 
+    SphereProjector MapRenderer::CreateProjector(const Buses& buses) const {
+        std::vector<geo::Coordinates> route_stops_coord;
+        for (const auto& [bus_number, bus] : buses) {
+            for (const auto& stop : bus->stops) {
+                route_stops_coord.push_back(stop->coordinates);
+            }
+        }
+        return SphereProjector(route_stops_coord.begin(), route_stops_coord.end(), render_settings_.width, render_settings_.height, render_settings_.padding);
+    }
+
     svg::Document MapRenderer::GetSVG(const Buses& buses) const {
         svg::Document result;
-        std::vector<geo::Coordinates> route_stops_coord;
         Stops all_stops;
         for (const auto& [bus_number, bus] : buses) {
             for (const auto& stop : bus->stops) {
-                route_stops_coord.push_back(stop->coordinates);
                 all_stops[stop->name] = stop;
             }
         }
-        SphereProjector sp(route_stops_coord.begin(), route_stops_coord.end(), render_settings_.width, render_settings_.height, render_settings_.padding);
+        const SphereProjector sp = CreateProjector(buses);
 
         for (const auto& line : GetRouteLines(buses, sp)) {
             result.Add(line);
@@ -176,4 +190,42 @@ namespace renderer {
         return result;
     }
 
-} // namespace renderer
\ No newline at end of file
+    svg::Document MapRenderer::GetIsochroneSVG(
+        const Buses& buses,
+        const std::vector<std::pair<const transport_catalogue::Stop*, double>>& reachable,
+        double max_time
+    ) const {
+        svg::Document result = GetSVG(buses);
+        const SphereProjector sp = CreateProjector(buses);
+        const size_t bands = std::max<size_t>(1, render_settings_.color_palette.size());
+
+        for (const auto& [stop, time] : reachable) {
+            size_t band = max_time > 0 ? static_cast<size_t>(time / max_time * bands) : 0;
+            band = std::min(band, bands - 1);
+
+            svg::Circle ring;
+            ring.SetCenter(sp(stop->coordinates));
+            ring.SetRadius(render_settings_.stop_radius * 2);
+            ring.SetFillColor("none");
+            ring.SetStrokeColor(render_settings_.color_palette.empty() ? svg::Color{ "black" } : render_settings_.color_palette[band]);
+            ring.SetStrokeWidth(render_settings_.line_width);
+            result.Add(ring);
+        }
+
+        return result;
+    }
+
+    const std::string& MapRenderer::GetRenderedMap(const transport_catalogue::TransportCatalogue& catalogue) const {
+        std::call_once(map_rendered_, [this, &catalogue] {
+            Buses buses;
+            for (const auto& bus : catalogue.GetBuses()) {
+                buses.insert(bus);
+            }
+            std::ostringstream out;
+            GetSVG(buses).Render(out);
+            rendered_map_ = out.str();
+        });
+        return rendered_map_;
+    }
+
+} // namespace renderer
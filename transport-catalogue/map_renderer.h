@@ -4,8 +4,12 @@
 #include "geo.h"
 #include "json.h"
 #include "domain.h"
+#include "transport_catalogue.h"
 
 #include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
 
 namespace renderer {
 
@@ -91,16 +95,31 @@ namespace renderer {
         using Stops = std::map<std::string_view, const transport_catalogue::Stop*>;
 
         void SetRendererSettings(const RenderSettings& settings);
+        const RenderSettings& GetRendererSettings() const;
 
         svg::Document GetSVG(const Buses& buses) const;
+        // Renders the map of every bus on the first call and hands out the same text afterwards.
+        // Safe to call from several threads; the settings must not change after the first call.
+        const std::string& GetRenderedMap(const transport_catalogue::TransportCatalogue& catalogue) const;
+        // The map of `buses` with a ring around every reachable stop. Rings take palette colors
+        // by time band, the first color for the stops closest to the origin
+        svg::Document GetIsochroneSVG(
+            const Buses& buses,
+            const std::vector<std::pair<const transport_catalogue::Stop*, double>>& reachable,
+            double max_time
+        ) const;
 
     private:
+        SphereProjector CreateProjector(const Buses& buses) const;
         std::vector<svg::Polyline> GetRouteLines(const Buses& buses, const SphereProjector& sp) const;
         std::vector<svg::Text> GetBusLabel(const Buses& buses, const SphereProjector& sp) const;
         std::vector<svg::Circle> GetStopsSymbols(const Stops& stops, const SphereProjector& sp) const;
         std::vector<svg::Text> GetStopsLabels(const Stops& stops, const SphereProjector& sp) const;
 
         RenderSettings render_settings_;
+
+        mutable std::once_flag map_rendered_;
+        mutable std::string rendered_map_;
     };
 
 } // namespace renderer
\ No newline at end of file
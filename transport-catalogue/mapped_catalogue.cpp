@@ -0,0 +1,435 @@
+#include "mapped_catalogue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace transport_catalogue {
+
+	namespace {
+		constexpr char MAGIC[8] = { 'T', 'C', 'M', 'A', 'P', 0, 0, 0 };
+		constexpr uint32_t VERSION = 2;
+		// Every section starts at a multiple of the widest field, so records can be read in place
+		constexpr uint64_t SECTION_ALIGNMENT = 8;
+
+		uint64_t Align(uint64_t offset) {
+			return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+		}
+	} // namespace
+
+	MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw MappedCatalogueError("cannot open " + path);
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			throw MappedCatalogueError("cannot map " + path);
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (!data) {
+			if (mapping) {
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+			throw MappedCatalogueError("cannot map " + path);
+		}
+		file_ = file;
+		mapping_ = mapping;
+		data_ = static_cast<const char*>(data);
+		size_ = static_cast<size_t>(size.QuadPart);
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw MappedCatalogueError("cannot open " + path);
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			close(fd);
+			throw MappedCatalogueError("cannot map " + path);
+		}
+		void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		// The mapping keeps its own reference to the file
+		close(fd);
+		if (data == MAP_FAILED) {
+			throw MappedCatalogueError("cannot map " + path);
+		}
+		data_ = static_cast<const char*>(data);
+		size_ = static_cast<size_t>(info.st_size);
+#endif
+	}
+
+	MappedFile::~MappedFile() {
+#ifdef _WIN32
+		UnmapViewOfFile(data_);
+		CloseHandle(mapping_);
+		CloseHandle(file_);
+#else
+		munmap(const_cast<char*>(data_), size_);
+#endif
+	}
+
+	const char* MappedFile::GetData() const {
+		return data_;
+	}
+
+	size_t MappedFile::GetSize() const {
+		return size_;
+	}
+
+	// All offsets are relative to the beginning of the file
+	struct MappedCatalogue::Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t stops_count;
+		uint32_t buses_count;
+		uint32_t reserved;
+		uint64_t stops_offset;
+		uint64_t buses_offset;
+		uint64_t route_stops_offset;
+		uint64_t route_stops_count;
+		uint64_t stop_buses_offset;
+		uint64_t stop_buses_count;
+		uint64_t distances_offset;
+		uint64_t distances_count;
+		uint64_t strings_offset;
+		uint64_t strings_size;
+	};
+
+	struct MappedCatalogue::StopRecord {
+		uint64_t name_offset;
+		uint32_t name_size;
+		uint32_t buses_count;
+		uint64_t buses_begin;
+		uint64_t distances_begin;
+		uint32_t distances_count;
+		uint32_t reserved;
+		double lat;
+		double lng;
+	};
+
+	struct MappedCatalogue::BusRecord {
+		uint64_t name_offset;
+		uint32_t name_size;
+		uint32_t stops_count;
+		uint64_t stops_begin;
+		uint8_t is_roundtrip;
+		uint8_t reserved[7];
+		// BusInfo, as computed when the route was added
+		uint32_t total_stops_count;
+		uint32_t unique_stops_count;
+		double route_length;
+		double geo_route_length;
+		double curvature;
+	};
+
+	// Road distance from the owning stop, sorted by destination id
+	struct MappedCatalogue::DistanceRecord {
+		uint32_t to;
+		int32_t distance;
+	};
+
+	MappedCatalogue::MappedCatalogue(const std::string& path)
+		: file_(path) {
+		static_assert(sizeof(Header) == 104);
+		static_assert(sizeof(StopRecord) == 56);
+		static_assert(sizeof(BusRecord) == 64);
+		static_assert(sizeof(DistanceRecord) == 8);
+
+		const char* data = file_.GetData();
+		const uint64_t size = file_.GetSize();
+		if (size < sizeof(Header)) {
+			throw MappedCatalogueError("mapped catalogue is truncated");
+		}
+		header_ = reinterpret_cast<const Header*>(data);
+		if (std::memcmp(header_->magic, MAGIC, sizeof(MAGIC)) != 0) {
+			throw MappedCatalogueError("not a mapped catalogue");
+		}
+		if (header_->version != VERSION) {
+			throw MappedCatalogueError("unsupported mapped catalogue version");
+		}
+
+		auto check_section = [size](uint64_t offset, uint64_t count, uint64_t item_size) {
+			if (offset % SECTION_ALIGNMENT != 0 || offset > size || count > (size - offset) / item_size) {
+				throw MappedCatalogueError("mapped catalogue section is out of bounds");
+			}
+		};
+		check_section(header_->stops_offset, header_->stops_count, sizeof(StopRecord));
+		check_section(header_->buses_offset, header_->buses_count, sizeof(BusRecord));
+		check_section(header_->route_stops_offset, header_->route_stops_count, sizeof(uint32_t));
+		check_section(header_->stop_buses_offset, header_->stop_buses_count, sizeof(uint32_t));
+		check_section(header_->distances_offset, header_->distances_count, sizeof(DistanceRecord));
+		check_section(header_->strings_offset, header_->strings_size, 1);
+
+		stops_ = reinterpret_cast<const StopRecord*>(data + header_->stops_offset);
+		buses_ = reinterpret_cast<const BusRecord*>(data + header_->buses_offset);
+		route_stops_ = reinterpret_cast<const uint32_t*>(data + header_->route_stops_offset);
+		stop_buses_ = reinterpret_cast<const uint32_t*>(data + header_->stop_buses_offset);
+		distances_ = reinterpret_cast<const DistanceRecord*>(data + header_->distances_offset);
+		strings_ = data + header_->strings_offset;
+	}
+
+	void MappedCatalogue::Write(const TransportCatalogue& catalogue, std::ostream& output) {
+		std::vector<const Stop*> stops;
+		stops.reserve(catalogue.GetStops().size());
+		for (const auto& [name, stop] : catalogue.GetStops()) {
+			stops.push_back(stop);
+		}
+		std::sort(stops.begin(), stops.end(), [](const Stop* lhs, const Stop* rhs) {
+			return lhs->name < rhs->name;
+			});
+
+		std::vector<const Bus*> buses;
+		buses.reserve(catalogue.GetBuses().size());
+		for (const auto& [number, bus] : catalogue.GetBuses()) {
+			buses.push_back(bus);
+		}
+		std::sort(buses.begin(), buses.end(), [](const Bus* lhs, const Bus* rhs) {
+			return lhs->number < rhs->number;
+			});
+
+		std::unordered_map<const Stop*, StopId> stop_ids;
+		for (size_t i = 0; i < stops.size(); ++i) {
+			stop_ids.emplace(stops[i], static_cast<StopId>(i));
+		}
+		std::unordered_map<std::string_view, BusId> bus_ids;
+		for (size_t i = 0; i < buses.size(); ++i) {
+			bus_ids.emplace(buses[i]->number, static_cast<BusId>(i));
+		}
+
+		std::vector<std::map<StopId, int>> distances_by_stop(stops.size());
+		for (size_t i = 0; i < stops.size(); ++i) {
+			for (const auto& [to, distance] : catalogue.GetDistancesFrom(stops[i])) {
+				distances_by_stop[i][stop_ids.at(catalogue.GetStop(to))] = distance;
+			}
+		}
+
+		std::string strings;
+		auto add_string = [&strings](const std::string& value) {
+			uint64_t offset = strings.size();
+			strings += value;
+			return offset;
+		};
+
+		std::vector<StopRecord> stop_records;
+		std::vector<uint32_t> stop_buses;
+		std::vector<DistanceRecord> distances;
+		stop_records.reserve(stops.size());
+		for (size_t i = 0; i < stops.size(); ++i) {
+			const Stop* stop = stops[i];
+			StopRecord record{};
+			record.name_offset = add_string(stop->name);
+			record.name_size = static_cast<uint32_t>(stop->name.size());
+			record.lat = stop->coordinates.lat;
+			record.lng = stop->coordinates.lng;
+
+			// Stop::buses is sorted by number, so the ids come out ascending
+			record.buses_begin = stop_buses.size();
+			record.buses_count = static_cast<uint32_t>(stop->buses.size());
+			for (const auto bus : stop->buses) {
+				stop_buses.push_back(bus_ids.at(catalogue.GetBus(bus)->number));
+			}
+
+			record.distances_begin = distances.size();
+			record.distances_count = static_cast<uint32_t>(distances_by_stop[i].size());
+			for (const auto& [to, distance] : distances_by_stop[i]) {
+				distances.push_back({ to, distance });
+			}
+			stop_records.push_back(record);
+		}
+
+		std::vector<BusRecord> bus_records;
+		std::vector<uint32_t> route_stops;
+		bus_records.reserve(buses.size());
+		for (const Bus* bus : buses) {
+			BusRecord record{};
+			record.name_offset = add_string(bus->number);
+			record.name_size = static_cast<uint32_t>(bus->number.size());
+			record.is_roundtrip = bus->is_roundtrip ? 1 : 0;
+			record.stops_begin = route_stops.size();
+			record.stops_count = static_cast<uint32_t>(bus->stops.size());
+			for (const Stop* stop : bus->stops) {
+				route_stops.push_back(stop_ids.at(stop));
+			}
+			const BusInfo& info = *catalogue.GetBusInfo(bus->number);
+			record.total_stops_count = static_cast<uint32_t>(info.stops_count);
+			record.unique_stops_count = static_cast<uint32_t>(info.unique_stops_count);
+			record.route_length = info.route_length;
+			record.geo_route_length = info.geo_route_length;
+			record.curvature = info.curvature;
+			bus_records.push_back(record);
+		}
+
+		Header header{};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.stops_count = static_cast<uint32_t>(stop_records.size());
+		header.buses_count = static_cast<uint32_t>(bus_records.size());
+		header.stops_offset = Align(sizeof(Header));
+		header.buses_offset = Align(header.stops_offset + stop_records.size() * sizeof(StopRecord));
+		header.route_stops_offset = Align(header.buses_offset + bus_records.size() * sizeof(BusRecord));
+		header.route_stops_count = route_stops.size();
+		header.stop_buses_offset = Align(header.route_stops_offset + route_stops.size() * sizeof(uint32_t));
+		header.stop_buses_count = stop_buses.size();
+		header.distances_offset = Align(header.stop_buses_offset + stop_buses.size() * sizeof(uint32_t));
+		header.distances_count = distances.size();
+		header.strings_offset = Align(header.distances_offset + distances.size() * sizeof(DistanceRecord));
+		header.strings_size = strings.size();
+
+		uint64_t position = 0;
+		auto write_section = [&output, &position](uint64_t offset, const void* data, size_t size) {
+			static const char padding[SECTION_ALIGNMENT] = {};
+			output.write(padding, static_cast<std::streamsize>(offset - position));
+			output.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+			position = offset + size;
+		};
+		write_section(0, &header, sizeof(header));
+		write_section(header.stops_offset, stop_records.data(), stop_records.size() * sizeof(StopRecord));
+		write_section(header.buses_offset, bus_records.data(), bus_records.size() * sizeof(BusRecord));
+		write_section(header.route_stops_offset, route_stops.data(), route_stops.size() * sizeof(uint32_t));
+		write_section(header.stop_buses_offset, stop_buses.data(), stop_buses.size() * sizeof(uint32_t));
+		write_section(header.distances_offset, distances.data(), distances.size() * sizeof(DistanceRecord));
+		write_section(header.strings_offset, strings.data(), strings.size());
+
+		if (!output) {
+			throw MappedCatalogueError("failed to write mapped catalogue");
+		}
+	}
+
+	std::optional<MappedCatalogue::StopView> MappedCatalogue::FindStop(std::string_view stop) const {
+		const StopRecord* begin = stops_;
+		const StopRecord* end = stops_ + header_->stops_count;
+		const StopRecord* it = std::lower_bound(begin, end, stop, [this](const StopRecord& record, std::string_view name) {
+			return GetString(record.name_offset, record.name_size) < name;
+			});
+		if (it == end || GetString(it->name_offset, it->name_size) != stop) {
+			return std::nullopt;
+		}
+		return GetStop(static_cast<StopId>(it - begin));
+	}
+
+	std::optional<MappedCatalogue::BusView> MappedCatalogue::FindRoute(std::string_view bus) const {
+		const BusRecord* begin = buses_;
+		const BusRecord* end = buses_ + header_->buses_count;
+		const BusRecord* it = std::lower_bound(begin, end, bus, [this](const BusRecord& record, std::string_view number) {
+			return GetString(record.name_offset, record.name_size) < number;
+			});
+		if (it == end || GetString(it->name_offset, it->name_size) != bus) {
+			return std::nullopt;
+		}
+		return GetBus(static_cast<BusId>(it - begin));
+	}
+
+	MappedCatalogue::StopView MappedCatalogue::GetStop(StopId id) const {
+		if (id >= header_->stops_count) {
+			throw std::out_of_range("stop id is out of range");
+		}
+		const StopRecord& record = stops_[id];
+		return { id, GetString(record.name_offset, record.name_size), { record.lat, record.lng } };
+	}
+
+	MappedCatalogue::BusView MappedCatalogue::GetBus(BusId id) const {
+		if (id >= header_->buses_count) {
+			throw std::out_of_range("bus id is out of range");
+		}
+		const BusRecord& record = buses_[id];
+		if (record.stops_begin + record.stops_count > header_->route_stops_count) {
+			throw MappedCatalogueError("bus stops are out of bounds");
+		}
+		const uint32_t* stops = route_stops_ + record.stops_begin;
+		return {
+			id,
+			GetString(record.name_offset, record.name_size),
+			record.is_roundtrip != 0,
+			IdRange(stops, stops + record.stops_count)
+		};
+	}
+
+	BusInfo MappedCatalogue::GetBusInfo(BusId id) const {
+		if (id >= header_->buses_count) {
+			throw std::out_of_range("bus id is out of range");
+		}
+		const BusRecord& record = buses_[id];
+		BusInfo info;
+		info.stops_count = record.total_stops_count;
+		info.unique_stops_count = record.unique_stops_count;
+		info.route_length = record.route_length;
+		info.geo_route_length = record.geo_route_length;
+		info.curvature = record.curvature;
+		return info;
+	}
+
+	MappedCatalogue::IdRange MappedCatalogue::GetBusesByStop(StopId id) const {
+		if (id >= header_->stops_count) {
+			throw std::out_of_range("stop id is out of range");
+		}
+		const StopRecord& record = stops_[id];
+		if (record.buses_begin + record.buses_count > header_->stop_buses_count) {
+			throw MappedCatalogueError("stop buses are out of bounds");
+		}
+		const uint32_t* buses = stop_buses_ + record.buses_begin;
+		return IdRange(buses, buses + record.buses_count);
+	}
+
+	double MappedCatalogue::GetDistance(StopId from, StopId to) const {
+		if (auto distance = FindDistance(from, to)) {
+			return *distance;
+		}
+		if (auto distance = FindDistance(to, from)) {
+			return *distance;
+		}
+		return 0;
+	}
+
+	size_t MappedCatalogue::GetStopsCount() const {
+		return header_->stops_count;
+	}
+
+	size_t MappedCatalogue::GetBusesCount() const {
+		return header_->buses_count;
+	}
+
+	std::string_view MappedCatalogue::GetString(uint64_t offset, uint32_t size) const {
+		if (offset > header_->strings_size || size > header_->strings_size - offset) {
+			throw MappedCatalogueError("string is out of bounds");
+		}
+		return { strings_ + offset, size };
+	}
+
+	std::optional<int> MappedCatalogue::FindDistance(StopId from, StopId to) const {
+		if (from >= header_->stops_count) {
+			throw std::out_of_range("stop id is out of range");
+		}
+		const StopRecord& record = stops_[from];
+		if (record.distances_begin + record.distances_count > header_->distances_count) {
+			throw MappedCatalogueError("stop distances are out of bounds");
+		}
+		const DistanceRecord* begin = distances_ + record.distances_begin;
+		const DistanceRecord* end = begin + record.distances_count;
+		const DistanceRecord* it = std::lower_bound(begin, end, to, [](const DistanceRecord& distance, StopId stop) {
+			return distance.to < stop;
+			});
+		if (it == end || it->to != to) {
+			return std::nullopt;
+		}
+		return it->distance;
+	}
+
+} // namespace transport_catalogue
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "geo.h"
+#include "ranges.h"
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace transport_catalogue {
+
+	// Read-only memory mapping of a whole file, shared between processes mapping the same file
+	class MappedFile {
+	public:
+		explicit MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const char* GetData() const;
+		size_t GetSize() const;
+
+	private:
+		const char* data_ = nullptr;
+		size_t size_ = 0;
+#ifdef _WIN32
+		void* file_ = nullptr;
+		void* mapping_ = nullptr;
+#endif
+	};
+
+	class MappedCatalogueError : public std::runtime_error {
+	public:
+		using runtime_error::runtime_error;
+	};
+
+	// Catalogue lookups straight over a mapped file. The file is made of position-independent
+	// arrays: stops and buses sorted by name (buses with their BusInfo), CSR lists of route stops,
+	// stop buses and road distances, and one string pool. Nothing is copied on load, names are
+	// views into the mapping.
+	class MappedCatalogue {
+	public:
+		using StopId = uint32_t;
+		using BusId = uint32_t;
+		using IdRange = ranges::Range<const uint32_t*>;
+
+		struct StopView {
+			StopId id = 0;
+			std::string_view name;
+			geo::Coordinates coordinates;
+		};
+
+		struct BusView {
+			BusId id = 0;
+			std::string_view number;
+			bool is_roundtrip = false;
+			IdRange stops{ nullptr, nullptr };
+		};
+
+		explicit MappedCatalogue(const std::string& path);
+
+		static void Write(const TransportCatalogue& catalogue, std::ostream& output);
+
+		std::optional<StopView> FindStop(std::string_view stop) const;
+		std::optional<BusView> FindRoute(std::string_view bus) const;
+
+		StopView GetStop(StopId id) const;
+		BusView GetBus(BusId id) const;
+		BusInfo GetBusInfo(BusId id) const;
+		// Buses passing through the stop, sorted by number
+		IdRange GetBusesByStop(StopId id) const;
+
+		double GetDistance(StopId from, StopId to) const;
+
+		size_t GetStopsCount() const;
+		size_t GetBusesCount() const;
+
+	private:
+		struct Header;
+		struct StopRecord;
+		struct BusRecord;
+		struct DistanceRecord;
+
+		std::string_view GetString(uint64_t offset, uint32_t size) const;
+		std::optional<int> FindDistance(StopId from, StopId to) const;
+
+		MappedFile file_;
+		const Header* header_ = nullptr;
+		const StopRecord* stops_ = nullptr;
+		const BusRecord* buses_ = nullptr;
+		const uint32_t* route_stops_ = nullptr;
+		const uint32_t* stop_buses_ = nullptr;
+		const DistanceRecord* distances_ = nullptr;
+		const char* strings_ = nullptr;
+	};
+
+} // namespace transport_catalogue
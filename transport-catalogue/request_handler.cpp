@@ -6,181 +6,377 @@ using namespace json;
 using namespace std::literals;
 
 namespace {
-    std::pair<double, double> CalculateRouteAndGeoLengths(const TransportCatalogue& catalogue, const Bus* bus_ptr) {
-        double route_length = 0;
-        double geo_length = 0.0;
-
-        for (size_t i = 0; i < bus_ptr->stops.size() - 1; ++i) {
-            auto from = bus_ptr->stops[i];
-            auto to = bus_ptr->stops[i + 1];
-            if (bus_ptr->is_roundtrip) {
-                route_length += catalogue.GetDistance(from, to);
-                geo_length += geo::ComputeDistance(from->coordinates, to->coordinates);
-            }
-            else {
-                route_length += catalogue.GetDistance(from, to) + catalogue.GetDistance(to, from);
-                geo_length += geo::ComputeDistance(from->coordinates, to->coordinates) * 2;
-            }
+    // RequestHandler and MappedRequestHandler answer Stop and Bus alike, only the lookups differ
+
+    void WriteBus(json::Writer& writer, int id, const BusInfo* bus_info) {
+        writer.StartDict();
+        if (!bus_info) {
+            writer.Key("error_message").Value("not found")
+                .Key("request_id").Value(id);
         }
+        else {
+            writer.Key("curvature").Value(bus_info->curvature)
+                .Key("request_id").Value(id)
+                .Key("route_length").Value(bus_info->route_length)
+                .Key("stop_count").Value(static_cast<int>(bus_info->stops_count))
+                .Key("unique_stop_count").Value(static_cast<int>(bus_info->unique_stops_count));
+        }
+        writer.EndDict();
+    }
 
-        return { route_length, geo_length };
+    // buses is null for an unknown stop, get_number turns its bus ids into numbers
+    template <typename BusIds, typename GetNumber>
+    void WriteStop(json::Writer& writer, int id, const BusIds* buses, GetNumber get_number) {
+        writer.StartDict();
+        if (!buses) {
+            writer.Key("error_message").Value("not found");
+        }
+        else {
+            writer.Key("buses").StartArray();
+            for (const BusId bus : *buses) {
+                writer.Value(get_number(bus));
+            }
+            writer.EndArray();
+        }
+        writer.Key("request_id").Value(id)
+            .EndDict();
     }
-}
+} // namespace
 
 void RequestHandler::ProcessRequests() const {
-    json::Array result;
+    ProcessRequests(std::cout, requests_.ParseOutputFormat());
+}
+
+void RequestHandler::ProcessRequests(std::ostream& output, json::Format format) const {
+    json::Writer writer(output, format);
+    writer.StartArray();
     const json::Array& arr = requests_.GetStatRequests().AsArray();
-    for (auto& request : arr) {
-        const auto& request_map = request.AsDict();
-        const auto& type = request_map.at("type").AsString();
-        if (type == "Stop") {
-            result.push_back(PrintStop(request_map).AsDict());
-        }
-        if (type == "Bus") {
-            result.push_back(PrintBus(request_map).AsDict());
-        }
-        if (type == "Map") {
-            result.push_back(PrintMap(request_map).AsDict());
+
+    if (!pool_) {
+        for (auto& request : arr) {
+            ProcessRequest(request.AsDict(), writer);
         }
-        if (type == "Route") {
-            result.push_back(PrintRoute(request_map).AsDict());
+    }
+    else {
+        std::vector<std::string> responses;
+        for (size_t begin = 0; begin < arr.size(); begin += PARALLEL_WINDOW) {
+            const size_t end = std::min(arr.size(), begin + PARALLEL_WINDOW);
+            responses.assign(end - begin, std::string());
+            pool_->ParallelFor(end - begin, [&](size_t i) {
+                std::ostringstream out;
+                {
+                    // Responses are items of the top-level array
+                    json::Writer response(out, format, 1);
+                    ProcessRequest(arr[begin + i].AsDict(), response);
+                }
+                responses[i] = out.str();
+            });
+            for (const auto& response : responses) {
+                if (!response.empty()) {
+                    writer.RawValue(response);
+                }
+            }
         }
     }
-    json::Print(json::Document{ result }, std::cout);
+
+    writer.EndArray();
 }
 
-const json::Node RequestHandler::PrintBus(const json::Dict& request_map) const {
-    json::Node result;
-    const std::string& route_number = request_map.at("name").AsString();
-    const int id = request_map.at("id").AsInt();
+std::unique_ptr<thread_pool::ThreadPool> RequestHandler::CreateThreadPool(size_t thread_count) {
+    if (thread_count == 1) {
+        return nullptr;
+    }
+    return std::make_unique<thread_pool::ThreadPool>(thread_count);
+}
 
-    if (!catalogue_.FindRoute(route_number)) {
-        result = json::Builder{}
-                .StartDict()
-                    .Key("request_id").Value(id)
-                    .Key("error_message").Value("not found")
-                .EndDict()
-            .Build();
+void RequestHandler::ProcessRequest(const json::Dict& request_map, json::Writer& writer) const {
+    const auto& type = request_map.at("type").AsString();
+    if (type == "Stop") {
+        PrintStop(request_map, writer);
     }
-    else {
-        const auto& route_info = GetBusInfo(route_number);
-        result = json::Builder{}
-                .StartDict()
-                    .Key("request_id").Value(id)
-                    .Key("curvature").Value(route_info->curvature)
-                    .Key("route_length").Value(route_info->route_length)
-                    .Key("stop_count").Value(static_cast<int>(route_info->stops_count))
-                    .Key("unique_stop_count").Value(static_cast<int>(route_info->unique_stops_count))
-                .EndDict()
-            .Build();
+    if (type == "Bus") {
+        PrintBus(request_map, writer);
+    }
+    if (type == "Map") {
+        PrintMap(request_map, writer);
+    }
+    if (type == "Route") {
+        PrintRoute(request_map, writer);
+    }
+    if (type == "RouteMatrix") {
+        PrintRouteMatrix(request_map, writer);
+    }
+    if (type == "Isochrone") {
+        PrintIsochrone(request_map, writer);
+    }
+    if (type == "NearestStops") {
+        PrintNearestStops(request_map, writer);
     }
-    return result;
+    if (type == "StopsInBox") {
+        PrintStopsInBox(request_map, writer);
+    }
+    if (type == "RouteCacheStats") {
+        PrintRouteCacheStats(request_map, writer);
+    }
+}
+
+// Keys are written in sorted order, as json::Print lays out a Dict
+
+void RequestHandler::PrintBus(const json::Dict& request_map, json::Writer& writer) const {
+    WriteBus(writer, request_map.at("id").AsInt(), catalogue_.GetBusInfo(request_map.at("name").AsString()));
+}
 
+void RequestHandler::PrintStop(const json::Dict& request_map, json::Writer& writer) const {
+    const Stop* stop = catalogue_.FindStop(request_map.at("name").AsString());
+    WriteStop(writer, request_map.at("id").AsInt(), stop ? &stop->buses : nullptr,
+        [this](BusId bus) { return std::string_view(catalogue_.GetBus(bus)->number); });
 }
 
-const json::Node RequestHandler::PrintStop(const json::Dict& request_map) const {
-    json::Node result;
-    const std::string& stop_name = request_map.at("name").AsString();
+void RequestHandler::PrintMap(const json::Dict& request_map, json::Writer& writer) const {
     const int id = request_map.at("id").AsInt();
 
-    if (!catalogue_.FindStop(stop_name)) {
-        result = json::Builder{}
-                .StartDict()
-                    .Key("request_id").Value(id)
-                    .Key("error_message").Value("not found")
-                .EndDict()
-            .Build();
+    writer.StartDict()
+        .Key("map").Value(renderer_.GetRenderedMap(catalogue_))
+        .Key("request_id").Value(id)
+        .EndDict();
+}
+
+void RequestHandler::PrintRoute(const json::Dict& request_map, json::Writer& writer) const {
+    const int id = request_map.at("id"s).AsInt();
+    const Stop* from = catalogue_.FindStop(request_map.at("from"s).AsString());
+    const Stop* to = catalogue_.FindStop(request_map.at("to"s).AsString());
+    const auto route = from && to ? router_.BuildRouteData(from, to) : nullptr;
+
+    writer.StartDict();
+    if (!route) {
+        writer.Key("error_message"sv).Value("not found"sv)
+            .Key("request_id"sv).Value(id);
     }
     else {
-        json::Array buses;
-        for (auto& bus : GetBusesByStop(stop_name)) {
-            buses.push_back(bus);
+        writer.Key("items"sv).StartArray();
+        for (const auto& item : route->items) {
+            writer.StartDict();
+            if (item.type == transport_router::RouteItemType::WAIT) {
+                writer.Key("stop_name"sv).Value(item.name)
+                    .Key("time"sv).Value(item.time)
+                    .Key("type"sv).Value("Wait"sv);
+            }
+            else {
+                writer.Key("bus"sv).Value(item.name)
+                    .Key("span_count"sv).Value(item.span_count)
+                    .Key("time"sv).Value(item.time)
+                    .Key("type"sv).Value("Bus"sv);
+            }
+            writer.EndDict();
         }
-        result = json::Builder{}
-                .StartDict()
-                    .Key("request_id").Value(id)
-                    .Key("buses").Value(buses)
-                .EndDict()
-            .Build();
+        writer.EndArray()
+            .Key("request_id"sv).Value(id)
+            .Key("total_time"sv).Value(route->total_time);
     }
-
-    return result;
+    writer.EndDict();
 }
 
-const json::Node RequestHandler::PrintMap(const json::Dict& request_map) const {
-    json::Node result;
-    const int id = request_map.at("id").AsInt();
-
-    svg::Document map = CreateMap();
-    std::ostringstream out;
-    map.Render(out);
+void RequestHandler::PrintRouteMatrix(const json::Dict& request_map, json::Writer& writer) const {
+    const int id = request_map.at("id"s).AsInt();
+    const auto from = FindStops(request_map.at("from"s));
+    // Without "to" the times go to every stop, and the answer lists them by name
+    const bool list_to = !request_map.count("to"s);
+    std::optional<std::vector<const Stop*>> to;
+    if (list_to) {
+        to.emplace();
+        to->reserve(catalogue_.GetStopCount());
+        for (const auto& [name, stop] : catalogue_.GetStops()) {
+            to->push_back(stop);
+        }
+        std::sort(to->begin(), to->end(), [](const Stop* lhs, const Stop* rhs) {
+            return lhs->name < rhs->name;
+        });
+    }
+    else {
+        to = FindStops(request_map.at("to"s));
+    }
 
-    result = json::Builder{}
-            .StartDict()
-                .Key("request_id").Value(id)
-                .Key("map").Value(out.str())
-            .EndDict()
-        .Build();
+    writer.StartDict();
+    if (!from || !to) {
+        writer.Key("error_message"sv).Value("not found"sv)
+            .Key("request_id"sv).Value(id);
+        writer.EndDict();
+        return;
+    }
 
-    return result;
+    const std::vector<double> times = router_.BuildRouteMatrix(*from, *to);
+    writer.Key("request_id"sv).Value(id)
+        .Key("times"sv).StartArray();
+    for (size_t row = 0; row < from->size(); ++row) {
+        writer.StartArray();
+        for (size_t column = 0; column < to->size(); ++column) {
+            const double time = times[row * to->size() + column];
+            if (time == transport_router::TransportRouter::NO_ROUTE) {
+                writer.Value(nullptr);
+            }
+            else {
+                writer.Value(time);
+            }
+        }
+        writer.EndArray();
+    }
+    writer.EndArray();
+    if (list_to) {
+        writer.Key("to"sv).StartArray();
+        for (const Stop* stop : *to) {
+            writer.Value(stop->name);
+        }
+        writer.EndArray();
+    }
+    writer.EndDict();
 }
 
-const json::Node request_handler::RequestHandler::PrintRoute(const json::Dict& request_map) const {
-    json::Node result;
+void RequestHandler::PrintIsochrone(const json::Dict& request_map, json::Writer& writer) const {
     const int id = request_map.at("id"s).AsInt();
-    const std::string_view from = request_map.at("from"s).AsString();
-    const std::string_view to = request_map.at("to"s).AsString();
-    const auto& route = router_.BuildRouteData(from, to);
+    const Stop* from = catalogue_.FindStop(request_map.at("from"s).AsString());
+    const double max_time = request_map.at("max_time"s).AsDouble();
+    const bool render_map = request_map.count("render_map"s) && request_map.at("render_map"s).AsBool();
 
-    if (!route) {
-        result = json::Builder{}
-                .StartDict()
-                    .Key("request_id"s).Value(id)
-                    .Key("error_message"s).Value("not found"s)
-                .EndDict()
-            .Build();
-    }
-    else {
-        result = json::Builder{}
-                .StartDict()
-                    .Key("request_id"s).Value(id)
-                    .Key("total_time"s).Value(route->total_time)
-                    .Key("items"s).Value(route->data)
-                .EndDict()
-            .Build();
+    writer.StartDict();
+    if (!from) {
+        writer.Key("error_message"sv).Value("not found"sv)
+            .Key("request_id"sv).Value(id);
+        writer.EndDict();
+        return;
     }
 
-    return result;
+    const auto reachable = router_.BuildIsochrone(from, max_time);
+    if (render_map) {
+        std::ostringstream out;
+        CreateIsochroneMap(reachable, max_time).Render(out);
+        writer.Key("map"sv).Value(out.str());
+    }
+    writer.Key("request_id"sv).Value(id)
+        .Key("stops"sv).StartArray();
+    for (const auto& [stop, time] : reachable) {
+        writer.StartDict()
+            .Key("stop_name"sv).Value(stop->name)
+            .Key("time"sv).Value(time)
+            .EndDict();
+    }
+    writer.EndArray()
+        .EndDict();
 }
 
-std::optional<transport_catalogue::BusInfo> RequestHandler::GetBusInfo(std::string_view bus) const {
-    BusInfo bus_info = {};
+void RequestHandler::PrintNearestStops(const json::Dict& request_map, json::Writer& writer) const {
+    const int id = request_map.at("id"s).AsInt();
+    const geo::Coordinates point{ request_map.at("latitude"s).AsDouble(), request_map.at("longitude"s).AsDouble() };
+    const int count = request_map.at("count"s).AsInt();
 
-    const Bus* bus_ptr = catalogue_.FindRoute(bus);
-    if (bus_ptr == nullptr) {
-        return std::nullopt;
+    writer.StartDict()
+        .Key("request_id"sv).Value(id)
+        .Key("stops"sv).StartArray();
+    for (const auto& [stop, distance] : catalogue_.FindNearestStops(point, static_cast<size_t>(std::max(count, 0)))) {
+        writer.StartDict()
+            .Key("distance"sv).Value(distance)
+            .Key("stop_name"sv).Value(stop->name)
+            .EndDict();
     }
-    auto [route_length, geo_length] = CalculateRouteAndGeoLengths(catalogue_, bus_ptr);
+    writer.EndArray()
+        .EndDict();
+}
 
-    bus_info.geo_route_length = geo_length;
-    bus_info.route_length = route_length;
-    bus_info.curvature = static_cast<double>(bus_info.route_length) / bus_info.geo_route_length;
+void RequestHandler::PrintStopsInBox(const json::Dict& request_map, json::Writer& writer) const {
+    const int id = request_map.at("id"s).AsInt();
+    const geo::Coordinates min{ request_map.at("min_latitude"s).AsDouble(), request_map.at("min_longitude"s).AsDouble() };
+    const geo::Coordinates max{ request_map.at("max_latitude"s).AsDouble(), request_map.at("max_longitude"s).AsDouble() };
 
-    bus_info.stops_count = bus_ptr->is_roundtrip ? bus_ptr->stops.size() : bus_ptr->stops.size() * 2 - 1;
-    bus_info.unique_stops_count = catalogue_.UniqueStopsCount(std::string(bus));
+    writer.StartDict()
+        .Key("request_id"sv).Value(id)
+        .Key("stops"sv).StartArray();
+    for (const Stop* stop : catalogue_.FindStopsInBox(min, max)) {
+        writer.Value(stop->name);
+    }
+    writer.EndArray()
+        .EndDict();
+}
 
-    return bus_info;
+void RequestHandler::PrintRouteCacheStats(const json::Dict& request_map, json::Writer& writer) const {
+    const int id = request_map.at("id"s).AsInt();
+    const lru_cache::CacheStats stats = router_.GetRouteCacheStats();
+
+    // Counters of a long-running server outgrow int, so they are written as they are
+    writer.StartDict()
+        .Key("capacity"sv).RawValue(std::to_string(stats.capacity))
+        .Key("hits"sv).RawValue(std::to_string(stats.hits))
+        .Key("misses"sv).RawValue(std::to_string(stats.misses))
+        .Key("request_id"sv).Value(id)
+        .Key("size"sv).RawValue(std::to_string(stats.size))
+        .EndDict();
 }
 
-const std::set<std::string> RequestHandler::GetBusesByStop(std::string_view stop_name) const {
-    return catalogue_.FindStop(stop_name)->buses;
+std::optional<std::vector<const Stop*>> RequestHandler::FindStops(const json::Node& names) const {
+    std::vector<const Stop*> stops;
+    if (names.IsString()) {
+        stops.push_back(catalogue_.FindStop(names.AsString()));
+    }
+    else {
+        stops.reserve(names.AsArray().size());
+        for (const auto& name : names.AsArray()) {
+            stops.push_back(catalogue_.FindStop(name.AsString()));
+        }
+    }
+    if (std::find(stops.begin(), stops.end(), nullptr) != stops.end()) {
+        return std::nullopt;
+    }
+    return stops;
 }
 
-svg::Document RequestHandler::CreateMap() const {
+svg::Document RequestHandler::CreateIsochroneMap(const std::vector<transport_router::ReachableStop>& reachable, double max_time) const {
     renderer::MapRenderer::Buses buses;
     for (const auto& bus : catalogue_.GetBuses()) {
         buses.insert(bus);
     }
 
-    return renderer_.GetSVG(buses);
+    std::vector<std::pair<const Stop*, double>> stops;
+    stops.reserve(reachable.size());
+    for (const auto& [stop, time] : reachable) {
+        stops.emplace_back(stop, time);
+    }
+    return renderer_.GetIsochroneSVG(buses, stops, max_time);
+}
+
+bool MappedRequestHandler::CanAnswer(const json::Array& stat_requests) {
+    return std::all_of(stat_requests.begin(), stat_requests.end(), [](const json::Node& request) {
+        const auto& type = request.AsDict().at("type").AsString();
+        return type == "Stop" || type == "Bus";
+    });
+}
+
+void MappedRequestHandler::ProcessRequests() const {
+    ProcessRequests(std::cout, requests_.ParseOutputFormat());
+}
+
+void MappedRequestHandler::ProcessRequests(std::ostream& output, json::Format format) const {
+    json::Writer writer(output, format);
+    writer.StartArray();
+    for (auto& request : requests_.GetStatRequests().AsArray()) {
+        const json::Dict& request_map = request.AsDict();
+        const auto& type = request_map.at("type").AsString();
+        if (type == "Stop") {
+            PrintStop(request_map, writer);
+        }
+        if (type == "Bus") {
+            PrintBus(request_map, writer);
+        }
+    }
+    writer.EndArray();
+}
+
+void MappedRequestHandler::PrintBus(const json::Dict& request_map, json::Writer& writer) const {
+    const auto bus = catalogue_.FindRoute(request_map.at("name").AsString());
+    const std::optional<BusInfo> bus_info = bus ? std::optional(catalogue_.GetBusInfo(bus->id)) : std::nullopt;
+    WriteBus(writer, request_map.at("id").AsInt(), bus_info ? &*bus_info : nullptr);
+}
+
+void MappedRequestHandler::PrintStop(const json::Dict& request_map, json::Writer& writer) const {
+    const auto stop = catalogue_.FindStop(request_map.at("name").AsString());
+    const std::optional<MappedCatalogue::IdRange> buses = stop ? std::optional(catalogue_.GetBusesByStop(stop->id)) : std::nullopt;
+    WriteStop(writer, request_map.at("id").AsInt(), buses ? &*buses : nullptr,
+        [this](BusId bus) { return catalogue_.GetBus(bus).number; });
 }
\ No newline at end of file
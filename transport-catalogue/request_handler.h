@@ -2,13 +2,17 @@
 
 #include "json.h"
 #include "json_reader.h"
-#include "json_builder.h"
 #include "transport_catalogue.h"
 #include "transport_router.h"
 #include "map_renderer.h"
+#include "mapped_catalogue.h"
+#include "thread_pool.h"
 
+#include <algorithm>
+#include <memory>
 #include <optional>
 #include <sstream>
+#include <vector>
 
 namespace request_handler {
     class RequestHandler {
@@ -22,24 +26,88 @@ namespace request_handler {
             requests_(requests),
             catalogue_(catalogue),
             router_(router),
-            renderer_(renderer)
+            renderer_(renderer),
+            own_pool_(CreateThreadPool(requests.ParseStatThreads())),
+            pool_(own_pool_.get())
+        {}
+        // Answers on a pool shared with other handlers, stat_settings.threads of the requests is
+        // ignored. Without a pool the requests are answered one by one.
+        RequestHandler(
+            json_reader::JsonReader& requests,
+            const transport_catalogue::TransportCatalogue& catalogue,
+            const transport_router::TransportRouter& router,
+            const renderer::MapRenderer& renderer,
+            thread_pool::ThreadPool* pool
+        ) :
+            requests_(requests),
+            catalogue_(catalogue),
+            router_(router),
+            renderer_(renderer),
+            pool_(pool)
         {}
 
+        // With more than one stat thread the requests are answered in parallel, a window
+        // at a time, and written out in their original order
         void ProcessRequests() const;
-        svg::Document CreateMap() const;
-
-        const json::Node PrintBus(const json::Dict& request_map) const;
-        const json::Node PrintStop(const json::Dict& request_map) const;
-        const json::Node PrintMap(const json::Dict& request_map) const;
-        const json::Node PrintRoute(const json::Dict& request_map) const;
+        void ProcessRequests(std::ostream& output, json::Format format) const;
+        svg::Document CreateIsochroneMap(const std::vector<transport_router::ReachableStop>& reachable, double max_time) const;
 
-        std::optional<transport_catalogue::BusInfo> GetBusInfo(std::string_view bus_number) const;
-        const std::set<std::string> GetBusesByStop(std::string_view stop_name) const;
+        // Each response is written out as soon as it is ready
+        void PrintBus(const json::Dict& request_map, json::Writer& writer) const;
+        void PrintStop(const json::Dict& request_map, json::Writer& writer) const;
+        void PrintMap(const json::Dict& request_map, json::Writer& writer) const;
+        void PrintRoute(const json::Dict& request_map, json::Writer& writer) const;
+        // "from" and "to" are stop names or arrays of them, the answer holds a row of times per origin
+        // with null where there is no route
+        void PrintRouteMatrix(const json::Dict& request_map, json::Writer& writer) const;
+        // Stops reachable from "from" within "max_time" minutes, with "render_map": true also the map
+        // with the reachable stops ringed
+        void PrintIsochrone(const json::Dict& request_map, json::Writer& writer) const;
+        // Up to "count" stops closest to ("latitude", "longitude") with their distances in meters
+        void PrintNearestStops(const json::Dict& request_map, json::Writer& writer) const;
+        // Names of the stops between ("min_latitude", "min_longitude") and ("max_latitude", "max_longitude")
+        void PrintStopsInBox(const json::Dict& request_map, json::Writer& writer) const;
+        // Route cache counters as they stand when the request is answered, for sizing route_cache_size
+        void PrintRouteCacheStats(const json::Dict& request_map, json::Writer& writer) const;
 
     private:
         const json_reader::JsonReader& requests_;
         const transport_catalogue::TransportCatalogue& catalogue_;
         const transport_router::TransportRouter& router_;
         const renderer::MapRenderer& renderer_;
+        std::unique_ptr<thread_pool::ThreadPool> own_pool_;
+        thread_pool::ThreadPool* pool_ = nullptr;
+
+        static constexpr size_t PARALLEL_WINDOW = 4096;
+
+        static std::unique_ptr<thread_pool::ThreadPool> CreateThreadPool(size_t thread_count);
+        void ProcessRequest(const json::Dict& request_map, json::Writer& writer) const;
+        // nullopt if any of the stops is unknown
+        std::optional<std::vector<const transport_catalogue::Stop*>> FindStops(const json::Node& names) const;
+    };
+
+    // Answers Stop and Bus requests straight from a mapped catalogue, with no snapshot to load
+    class MappedRequestHandler {
+    public:
+        MappedRequestHandler(
+            json_reader::JsonReader& requests,
+            const transport_catalogue::MappedCatalogue& catalogue
+        ) :
+            requests_(requests),
+            catalogue_(catalogue)
+        {}
+
+        // True when every request is a Stop or Bus lookup, the rest need the full base
+        static bool CanAnswer(const json::Array& stat_requests);
+
+        void ProcessRequests() const;
+        void ProcessRequests(std::ostream& output, json::Format format) const;
+
+        void PrintBus(const json::Dict& request_map, json::Writer& writer) const;
+        void PrintStop(const json::Dict& request_map, json::Writer& writer) const;
+
+    private:
+        const json_reader::JsonReader& requests_;
+        const transport_catalogue::MappedCatalogue& catalogue_;
     };
 } // namespace request_handler
\ No newline at end of file
@@ -1,26 +1,58 @@
 #pragma once
 
+#include "contraction_hierarchy.h"
 #include "graph.h"
 
 #include <algorithm>
 #include <cassert>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <queue>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace graph {
 
+// EAGER precomputes all-pairs routes in the constructor (O(V^3) time, O(V^2) memory),
+// ON_DEMAND answers every BuildRoute with a single-source Dijkstra search,
+// CONTRACTION_HIERARCHIES preprocesses the graph once and answers with bidirectional upward searches
+enum class RouterMode {
+    EAGER,
+    ON_DEMAND,
+    CONTRACTION_HIERARCHIES,
+};
+
+// Scalar the EAGER precompute stores per matrix cell instead of the whole Weight.
+// Specialize for weights that carry more than a single value.
+template <typename Weight>
+struct WeightTraits {
+    using Value = Weight;
+
+    static Value ToValue(const Weight& weight) {
+        return weight;
+    }
+    static Weight FromValue(const Value& value) {
+        return value;
+    }
+};
+
 template <typename Weight>
 class Router {
 private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
-    explicit Router(const Graph& graph);
+    // thread_count is used only by the EAGER precompute, 0 means one thread per hardware core
+    explicit Router(const Graph& graph, RouterMode mode = RouterMode::EAGER, size_t thread_count = 1);
 
     struct RouteInfo {
         Weight weight;
@@ -28,84 +60,292 @@ public:
     };
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Weights of the shortest routes from one vertex to every vertex, nullopt where there is none.
+    // EAGER reads its precomputed row, the other modes run a single full Dijkstra sweep
+    std::vector<std::optional<Weight>> BuildWeightsFrom(VertexId from) const;
+    // Vertices whose shortest route from `from` weighs no more than `budget`, in no particular order.
+    // The search never expands past the budget, whatever the mode; none are within a negative one
+    std::vector<std::pair<VertexId, Weight>> BuildWeightsWithin(VertexId from, const Weight& budget) const;
+
+    using WeightValue = typename WeightTraits<Weight>::Value;
+    static constexpr uint32_t UNREACHABLE = std::numeric_limits<uint32_t>::max();
+    static constexpr uint32_t NO_PREV_EDGE = UNREACHABLE - 1;
+
+    // Row-major vertex_count x vertex_count matrices, prev_edges holds UNREACHABLE
+    // for missing routes and NO_PREV_EDGE for the empty route from a vertex to itself
+    struct RoutesInternalData {
+        size_t vertex_count = 0;
+        std::vector<WeightValue> weights;
+        std::vector<uint32_t> prev_edges;
+
+        size_t Index(VertexId from, VertexId to) const {
+            return from * vertex_count + to;
+        }
+    };
+
+    // Restore a router from previously built data without recomputation
+    Router(const Graph& graph, RoutesInternalData routes_internal_data);
+    Router(const Graph& graph, ContractionHierarchy<Weight> contraction_hierarchy);
+
+    RouterMode GetMode() const {
+        return mode_;
+    }
+    const RoutesInternalData& GetRoutesInternalData() const {
+        return routes_internal_data_;
+    }
+    const ContractionHierarchy<Weight>* GetContractionHierarchy() const {
+        return contraction_hierarchy_.get();
+    }
 
 private:
     struct RouteInternalData {
         Weight weight;
         std::optional<EdgeId> prev_edge;
     };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+
+    std::optional<RouteInfo> BuildRouteEager(VertexId from, VertexId to) const;
+    std::optional<RouteInfo> BuildRouteOnDemand(VertexId from, VertexId to) const;
+    std::optional<RouteInfo> BuildRouteContracted(VertexId from, VertexId to) const;
+    // Stops once `to` is settled, searches the whole graph without it. Routes heavier than
+    // `budget` are not followed, and a negative budget leaves even `from` unreached
+    std::vector<std::optional<RouteInternalData>> SearchFrom(VertexId from, std::optional<VertexId> to,
+                                                             const std::optional<Weight>& budget = std::nullopt) const;
+
+    void CheckEdgesWeights(const Graph& graph) const {
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+    }
 
     void InitializeRoutesInternalData(const Graph& graph) {
         const size_t vertex_count = graph.GetVertexCount();
+        if (graph.GetEdgeCount() >= NO_PREV_EDGE) {
+            throw std::length_error("Too many edges for the precomputed router");
+        }
+        routes_internal_data_.vertex_count = vertex_count;
+        routes_internal_data_.weights.assign(vertex_count * vertex_count, WeightValue{});
+        routes_internal_data_.prev_edges.assign(vertex_count * vertex_count, UNREACHABLE);
+
+        const WeightValue zero_value = WeightTraits<Weight>::ToValue(ZERO_WEIGHT);
         for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+            const size_t diagonal_index = routes_internal_data_.Index(vertex, vertex);
+            routes_internal_data_.weights[diagonal_index] = zero_value;
+            routes_internal_data_.prev_edges[diagonal_index] = NO_PREV_EDGE;
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                const size_t index = routes_internal_data_.Index(vertex, edge.to);
+                const WeightValue edge_value = WeightTraits<Weight>::ToValue(edge.weight);
+                if (routes_internal_data_.prev_edges[index] == UNREACHABLE
+                    || edge_value < routes_internal_data_.weights[index]) {
+                    routes_internal_data_.weights[index] = edge_value;
+                    routes_internal_data_.prev_edges[index] = static_cast<uint32_t>(edge_id);
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+    // Relaxes rows [row_begin, row_end). Row and column vertex_through don't change
+    // while relaxing through it, so different row ranges can be relaxed concurrently
+    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through,
+                                              VertexId row_begin, VertexId row_end) {
+        const WeightValue* through_weights = &routes_internal_data_.weights[routes_internal_data_.Index(vertex_through, 0)];
+        const uint32_t* through_prev_edges = &routes_internal_data_.prev_edges[routes_internal_data_.Index(vertex_through, 0)];
+        for (VertexId vertex_from = row_begin; vertex_from < row_end; ++vertex_from) {
+            const size_t from_index = routes_internal_data_.Index(vertex_from, vertex_through);
+            const uint32_t from_prev_edge = routes_internal_data_.prev_edges[from_index];
+            if (from_prev_edge == UNREACHABLE) {
+                continue;
+            }
+            const WeightValue from_weight = routes_internal_data_.weights[from_index];
+            WeightValue* row_weights = &routes_internal_data_.weights[routes_internal_data_.Index(vertex_from, 0)];
+            uint32_t* row_prev_edges = &routes_internal_data_.prev_edges[routes_internal_data_.Index(vertex_from, 0)];
+            for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
+                const uint32_t through_prev_edge = through_prev_edges[vertex_to];
+                if (through_prev_edge == UNREACHABLE) {
+                    continue;
+                }
+                const WeightValue candidate_weight = from_weight + through_weights[vertex_to];
+                if (row_prev_edges[vertex_to] == UNREACHABLE || candidate_weight < row_weights[vertex_to]) {
+                    row_weights[vertex_to] = candidate_weight;
+                    row_prev_edges[vertex_to] = through_prev_edge != NO_PREV_EDGE ? through_prev_edge : from_prev_edge;
+                }
+            }
         }
     }
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
+    class Barrier {
+    public:
+        explicit Barrier(size_t count)
+            : count_(count) {
+        }
+
+        void Wait() {
+            std::unique_lock lock(mutex_);
+            const size_t generation = generation_;
+            if (++waiting_ == count_) {
+                waiting_ = 0;
+                ++generation_;
+                condition_.notify_all();
+                return;
+            }
+            condition_.wait(lock, [this, generation] { return generation != generation_; });
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        size_t count_;
+        size_t waiting_ = 0;
+        size_t generation_ = 0;
+    };
+
+    // Every thread owns a contiguous block of rows and all threads meet at a barrier
+    // after each vertex_through, so the relaxation order and the result match the serial build
+    void RelaxRoutesInternalData(size_t vertex_count, size_t thread_count) {
+        thread_count = std::max<size_t>(1, std::min(thread_count, vertex_count / MIN_ROWS_PER_THREAD));
+        const size_t rows_per_thread = (vertex_count + thread_count - 1) / thread_count;
+        Barrier barrier(thread_count);
+
+        auto relax_rows = [this, vertex_count, thread_count, &barrier](VertexId row_begin, VertexId row_end) {
+            for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
+                RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through, row_begin, row_end);
+                if (thread_count > 1) {
+                    barrier.Wait();
                 }
             }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(thread_count - 1);
+        for (size_t thread_index = 1; thread_index < thread_count; ++thread_index) {
+            const VertexId row_begin = std::min(vertex_count, thread_index * rows_per_thread);
+            const VertexId row_end = std::min(vertex_count, row_begin + rows_per_thread);
+            workers.emplace_back(relax_rows, row_begin, row_end);
+        }
+        relax_rows(0, std::min(vertex_count, rows_per_thread));
+        for (auto& worker : workers) {
+            worker.join();
         }
     }
 
     static constexpr Weight ZERO_WEIGHT{};
+    static constexpr size_t MIN_ROWS_PER_THREAD = 64;
     const Graph& graph_;
+    RouterMode mode_;
     RoutesInternalData routes_internal_data_;
+    std::unique_ptr<ContractionHierarchy<Weight>> contraction_hierarchy_;
 };
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+Router<Weight>::Router(const Graph& graph, RouterMode mode, size_t thread_count)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , mode_(mode)
 {
+    if (mode_ == RouterMode::ON_DEMAND) {
+        CheckEdgesWeights(graph);
+        return;
+    }
+    if (mode_ == RouterMode::CONTRACTION_HIERARCHIES) {
+        contraction_hierarchy_ = std::make_unique<ContractionHierarchy<Weight>>(graph);
+        return;
+    }
+
     InitializeRoutesInternalData(graph);
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    RelaxRoutesInternalData(graph.GetVertexCount(), thread_count);
+}
+
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, RoutesInternalData routes_internal_data)
+    : graph_(graph)
+    , mode_(RouterMode::EAGER)
+    , routes_internal_data_(std::move(routes_internal_data))
+{
+    const size_t vertex_count = routes_internal_data_.vertex_count;
+    if (vertex_count != graph.GetVertexCount()
+        || routes_internal_data_.weights.size() != vertex_count * vertex_count
+        || routes_internal_data_.prev_edges.size() != vertex_count * vertex_count) {
+        throw std::invalid_argument("Routes data doesn't match the graph");
+    }
+}
+
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, ContractionHierarchy<Weight> contraction_hierarchy)
+    : graph_(graph)
+    , mode_(RouterMode::CONTRACTION_HIERARCHIES)
+    , contraction_hierarchy_(std::make_unique<ContractionHierarchy<Weight>>(std::move(contraction_hierarchy)))
+{
+    if (contraction_hierarchy_->GetVertexCount() != graph.GetVertexCount()) {
+        throw std::invalid_argument("Contraction hierarchy doesn't match the graph");
     }
 }
 
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+    switch (mode_) {
+    case RouterMode::ON_DEMAND:
+        return BuildRouteOnDemand(from, to);
+    case RouterMode::CONTRACTION_HIERARCHIES:
+        return BuildRouteContracted(from, to);
+    default:
+        return BuildRouteEager(from, to);
+    }
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRouteEager(VertexId from,
+                                                                                  VertexId to) const {
+    const size_t vertex_count = routes_internal_data_.vertex_count;
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const size_t index = routes_internal_data_.Index(from, to);
+    if (routes_internal_data_.prev_edges[index] == UNREACHABLE) {
+        return std::nullopt;
+    }
+    const Weight weight = WeightTraits<Weight>::FromValue(routes_internal_data_.weights[index]);
+    std::vector<EdgeId> edges;
+    for (uint32_t edge_id = routes_internal_data_.prev_edges[index];
+         edge_id != NO_PREV_EDGE;
+         edge_id = routes_internal_data_.prev_edges[routes_internal_data_.Index(from, graph_.GetEdge(edge_id).from)])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{weight, std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRouteOnDemand(VertexId from,
+                                                                                     VertexId to) const {
+    const auto routes_internal_data = SearchFrom(from, to);
+    if (!routes_internal_data[to]) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
+    const Weight weight = routes_internal_data[to]->weight;
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
+    for (std::optional<EdgeId> edge_id = routes_internal_data[to]->prev_edge;
          edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+         edge_id = routes_internal_data[graph_.GetEdge(*edge_id).from]->prev_edge)
     {
         edges.push_back(*edge_id);
     }
@@ -114,4 +354,98 @@ std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(Ver
     return RouteInfo{weight, std::move(edges)};
 }
 
-}  // namespace graph
\ No newline at end of file
+template <typename Weight>
+std::vector<std::optional<typename Router<Weight>::RouteInternalData>> Router<Weight>::SearchFrom(
+    VertexId from, std::optional<VertexId> to, const std::optional<Weight>& budget) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || (to && *to >= vertex_count)) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    std::vector<std::optional<RouteInternalData>> routes_internal_data(vertex_count);
+    if (budget && *budget < ZERO_WEIGHT) {
+        return routes_internal_data;
+    }
+    std::vector<bool> is_settled(vertex_count, false);
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+    routes_internal_data[from] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+    queue.push({ZERO_WEIGHT, from});
+    while (!queue.empty()) {
+        const QueueItem item = queue.top();
+        queue.pop();
+        if (is_settled[item.vertex]) {
+            continue;
+        }
+        is_settled[item.vertex] = true;
+        if (item.vertex == to) {
+            break;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (is_settled[edge.to]) {
+                continue;
+            }
+            const Weight candidate_weight = item.weight + edge.weight;
+            if (budget && *budget < candidate_weight) {
+                continue;
+            }
+            auto& route_relaxing = routes_internal_data[edge.to];
+            if (!route_relaxing || candidate_weight < route_relaxing->weight) {
+                route_relaxing = RouteInternalData{candidate_weight, edge_id};
+                queue.push({candidate_weight, edge.to});
+            }
+        }
+    }
+    return routes_internal_data;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> Router<Weight>::BuildWeightsFrom(VertexId from) const {
+    std::vector<std::optional<Weight>> weights(graph_.GetVertexCount());
+    if (mode_ == RouterMode::EAGER) {
+        if (from >= routes_internal_data_.vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        for (VertexId to = 0; to < weights.size(); ++to) {
+            const size_t index = routes_internal_data_.Index(from, to);
+            if (routes_internal_data_.prev_edges[index] != UNREACHABLE) {
+                weights[to] = WeightTraits<Weight>::FromValue(routes_internal_data_.weights[index]);
+            }
+        }
+        return weights;
+    }
+
+    const auto routes_internal_data = SearchFrom(from, std::nullopt);
+    for (VertexId to = 0; to < weights.size(); ++to) {
+        if (routes_internal_data[to]) {
+            weights[to] = routes_internal_data[to]->weight;
+        }
+    }
+    return weights;
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRouteContracted(VertexId from,
+                                                                                       VertexId to) const {
+    std::vector<EdgeId> edges;
+    const std::optional<Weight> weight = contraction_hierarchy_->BuildRoute(from, to, edges);
+    if (!weight) {
+        return std::nullopt;
+    }
+    return RouteInfo{*weight, std::move(edges)};
+}
+
+template <typename Weight>
+std::vector<std::pair<VertexId, Weight>> Router<Weight>::BuildWeightsWithin(VertexId from, const Weight& budget) const {
+    const auto routes_internal_data = SearchFrom(from, std::nullopt, budget);
+    std::vector<std::pair<VertexId, Weight>> weights;
+    for (VertexId to = 0; to < routes_internal_data.size(); ++to) {
+        if (routes_internal_data[to]) {
+            weights.emplace_back(to, routes_internal_data[to]->weight);
+        }
+    }
+    return weights;
+}
+
+}  // namespace graph
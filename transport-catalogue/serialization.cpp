@@ -0,0 +1,470 @@
+#include "serialization.h"
+
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+using namespace transport_catalogue;
+using namespace transport_router;
+
+namespace serialization {
+
+    namespace {
+        using namespace std::literals;
+
+        using Graph = graph::DirectedWeightedGraph<RouteWeight>;
+        using Router = graph::Router<RouteWeight>;
+        using ContractionHierarchy = graph::ContractionHierarchy<RouteWeight>;
+        using WeightTraits = graph::WeightTraits<RouteWeight>;
+
+        constexpr std::string_view MAGIC = "TCSNAP"sv;
+        constexpr uint32_t VERSION = 2;
+        constexpr uint32_t NO_BUS = std::numeric_limits<uint32_t>::max();
+
+        class Writer {
+        public:
+            explicit Writer(std::ostream& output)
+                : output_(output)
+            {}
+
+            template <typename T>
+            void Value(const T& value) {
+                static_assert(std::is_trivially_copyable_v<T>);
+                output_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+            }
+
+            void Size(size_t size) {
+                Value(static_cast<uint64_t>(size));
+            }
+
+            void String(std::string_view value) {
+                Size(value.size());
+                output_.write(value.data(), value.size());
+            }
+
+            template <typename T>
+            void Array(const std::vector<T>& values) {
+                static_assert(std::is_trivially_copyable_v<T>);
+                Size(values.size());
+                output_.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+            }
+
+        private:
+            std::ostream& output_;
+        };
+
+        class Reader {
+        public:
+            explicit Reader(std::istream& input)
+                : input_(input)
+            {}
+
+            template <typename T>
+            T Value() {
+                static_assert(std::is_trivially_copyable_v<T>);
+                T value;
+                Read(&value, sizeof(T));
+                return value;
+            }
+
+            size_t Size() {
+                return static_cast<size_t>(Value<uint64_t>());
+            }
+
+            std::string String() {
+                std::string value(Size(), '\0');
+                Read(value.data(), value.size());
+                return value;
+            }
+
+            template <typename T>
+            std::vector<T> Array() {
+                static_assert(std::is_trivially_copyable_v<T>);
+                std::vector<T> values(Size());
+                Read(values.data(), values.size() * sizeof(T));
+                return values;
+            }
+
+        private:
+            void Read(void* data, size_t size) {
+                input_.read(static_cast<char*>(data), size);
+                if (!input_) {
+                    throw SnapshotError("Unexpected end of snapshot"s);
+                }
+            }
+
+            std::istream& input_;
+        };
+
+        template <typename T>
+        const T& CheckedAt(const std::vector<T>& values, size_t index) {
+            if (index >= values.size()) {
+                throw SnapshotError("Snapshot refers to a missing element"s);
+            }
+            return values[index];
+        }
+
+        // Catalogue
+
+        // Stops and buses are written in id order, so their ids in the snapshot are the catalogue ids
+        void SaveCatalogue(Writer& writer, const TransportCatalogue& catalogue) {
+            writer.Size(catalogue.GetStopCount());
+            size_t distances_count = 0;
+            for (StopId id = 0; id < catalogue.GetStopCount(); ++id) {
+                const Stop* stop = catalogue.GetStop(id);
+                writer.String(stop->name);
+                writer.Value(stop->coordinates.lat);
+                writer.Value(stop->coordinates.lng);
+                const auto distances = catalogue.GetDistancesFrom(stop);
+                distances_count += std::distance(distances.begin(), distances.end());
+            }
+
+            writer.Size(distances_count);
+            for (StopId id = 0; id < catalogue.GetStopCount(); ++id) {
+                for (const auto& [to, distance] : catalogue.GetDistancesFrom(catalogue.GetStop(id))) {
+                    writer.Value(id);
+                    writer.Value(to);
+                    writer.Value(static_cast<int32_t>(distance));
+                }
+            }
+
+            writer.Size(catalogue.GetBusCount());
+            for (BusId id = 0; id < catalogue.GetBusCount(); ++id) {
+                const Bus* bus = catalogue.GetBus(id);
+                writer.String(bus->number);
+                writer.Value(static_cast<uint8_t>(bus->is_roundtrip));
+                writer.Size(bus->stops.size());
+                for (const Stop* stop : bus->stops) {
+                    writer.Value(stop->id);
+                }
+            }
+        }
+
+        struct CatalogueRefs {
+            std::vector<const Stop*> stops;
+            std::vector<std::string_view> buses;
+        };
+
+        CatalogueRefs LoadCatalogue(Reader& reader, TransportCatalogue& catalogue) {
+            CatalogueRefs refs;
+
+            const size_t stops_count = reader.Size();
+            refs.stops.reserve(stops_count);
+            for (size_t i = 0; i < stops_count; ++i) {
+                std::string name = reader.String();
+                geo::Coordinates coordinates;
+                coordinates.lat = reader.Value<double>();
+                coordinates.lng = reader.Value<double>();
+                catalogue.AddStop(name, coordinates);
+                refs.stops.push_back(catalogue.FindStop(name));
+            }
+
+            const size_t distances_count = reader.Size();
+            for (size_t i = 0; i < distances_count; ++i) {
+                const Stop* from = CheckedAt(refs.stops, reader.Value<uint32_t>());
+                const Stop* to = CheckedAt(refs.stops, reader.Value<uint32_t>());
+                catalogue.SetDistance({ from, to }, reader.Value<int32_t>());
+            }
+
+            const size_t buses_count = reader.Size();
+            refs.buses.reserve(buses_count);
+            for (size_t i = 0; i < buses_count; ++i) {
+                std::string number = reader.String();
+                const bool is_roundtrip = reader.Value<uint8_t>() != 0;
+                std::vector<const Stop*> stops(reader.Size());
+                for (const Stop*& stop : stops) {
+                    stop = CheckedAt(refs.stops, reader.Value<uint32_t>());
+                }
+                catalogue.AddRoute(number, stops, is_roundtrip);
+                refs.buses.push_back(catalogue.FindRoute(number)->number);
+            }
+
+            return refs;
+        }
+
+        // Render settings
+
+        void SavePoint(Writer& writer, svg::Point point) {
+            writer.Value(point.x);
+            writer.Value(point.y);
+        }
+
+        svg::Point LoadPoint(Reader& reader) {
+            svg::Point point;
+            point.x = reader.Value<double>();
+            point.y = reader.Value<double>();
+            return point;
+        }
+
+        void SaveColor(Writer& writer, const svg::Color& color) {
+            writer.Value(static_cast<uint8_t>(color.index()));
+            if (const auto* name = std::get_if<std::string>(&color)) {
+                writer.String(*name);
+            }
+            else if (const auto* rgba = std::get_if<svg::Rgba>(&color)) {
+                writer.Value(rgba->red);
+                writer.Value(rgba->green);
+                writer.Value(rgba->blue);
+                writer.Value(rgba->opacity);
+            }
+            else if (const auto* rgb = std::get_if<svg::Rgb>(&color)) {
+                writer.Value(rgb->red);
+                writer.Value(rgb->green);
+                writer.Value(rgb->blue);
+            }
+        }
+
+        svg::Color LoadColor(Reader& reader) {
+            switch (reader.Value<uint8_t>()) {
+            case 0:
+                return svg::NoneColor;
+            case 1:
+                return reader.String();
+            case 2: {
+                const auto red = reader.Value<uint8_t>();
+                const auto green = reader.Value<uint8_t>();
+                const auto blue = reader.Value<uint8_t>();
+                return svg::Rgb(red, green, blue);
+            }
+            case 3: {
+                const auto red = reader.Value<uint8_t>();
+                const auto green = reader.Value<uint8_t>();
+                const auto blue = reader.Value<uint8_t>();
+                return svg::Rgba(red, green, blue, reader.Value<double>());
+            }
+            default:
+                throw SnapshotError("Unknown color type"s);
+            }
+        }
+
+        void SaveRenderSettings(Writer& writer, const renderer::RenderSettings& settings) {
+            writer.Value(settings.width);
+            writer.Value(settings.height);
+            writer.Value(settings.padding);
+            writer.Value(settings.line_width);
+            writer.Value(settings.stop_radius);
+            writer.Value(static_cast<int32_t>(settings.bus_label_font_size));
+            SavePoint(writer, settings.bus_label_offset);
+            writer.Value(static_cast<int32_t>(settings.stop_label_font_size));
+            SavePoint(writer, settings.stop_label_offset);
+            SaveColor(writer, settings.underlayer_color);
+            writer.Value(settings.underlayer_width);
+            writer.Size(settings.color_palette.size());
+            for (const auto& color : settings.color_palette) {
+                SaveColor(writer, color);
+            }
+        }
+
+        renderer::RenderSettings LoadRenderSettings(Reader& reader) {
+            renderer::RenderSettings settings;
+            settings.width = reader.Value<double>();
+            settings.height = reader.Value<double>();
+            settings.padding = reader.Value<double>();
+            settings.line_width = reader.Value<double>();
+            settings.stop_radius = reader.Value<double>();
+            settings.bus_label_font_size = reader.Value<int32_t>();
+            settings.bus_label_offset = LoadPoint(reader);
+            settings.stop_label_font_size = reader.Value<int32_t>();
+            settings.stop_label_offset = LoadPoint(reader);
+            settings.underlayer_color = LoadColor(reader);
+            settings.underlayer_width = reader.Value<double>();
+            const size_t palette_size = reader.Size();
+            for (size_t i = 0; i < palette_size; ++i) {
+                settings.color_palette.push_back(LoadColor(reader));
+            }
+            return settings;
+        }
+
+        // Router
+
+        void SaveRouterSettings(Writer& writer, const RouterSettings& settings) {
+            writer.Value(settings.bus_wait_time);
+            writer.Value(settings.bus_velocity);
+            writer.Value(static_cast<uint8_t>(settings.router_mode));
+            writer.Value(static_cast<uint8_t>(settings.graph_model));
+            writer.Size(settings.router_threads);
+            writer.Size(settings.route_cache_size);
+        }
+
+        RouterSettings LoadRouterSettings(Reader& reader) {
+            RouterSettings settings;
+            settings.bus_wait_time = reader.Value<double>();
+            settings.bus_velocity = reader.Value<double>();
+            settings.router_mode = static_cast<graph::RouterMode>(reader.Value<uint8_t>());
+            settings.graph_model = static_cast<GraphModel>(reader.Value<uint8_t>());
+            settings.router_threads = reader.Size();
+            settings.route_cache_size = reader.Size();
+            return settings;
+        }
+
+        void SaveGraph(Writer& writer, const Graph& graph, const TransportCatalogue& catalogue) {
+            writer.Size(graph.GetVertexCount());
+            writer.Size(graph.GetEdgeCount());
+            for (graph::EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+                const auto& edge = graph.GetEdge(edge_id);
+                writer.Value(static_cast<uint64_t>(edge.from));
+                writer.Value(static_cast<uint64_t>(edge.to));
+                writer.Value(edge.weight.bus_name.empty() ? NO_BUS : catalogue.FindRoute(edge.weight.bus_name)->id);
+                writer.Value(edge.weight.total_time);
+                writer.Value(static_cast<int32_t>(edge.weight.span_count));
+                writer.Value(static_cast<uint8_t>(edge.weight.type));
+            }
+        }
+
+        Graph LoadGraph(Reader& reader, const CatalogueRefs& refs) {
+            Graph graph(reader.Size());
+            const size_t edges_count = reader.Size();
+            for (size_t i = 0; i < edges_count; ++i) {
+                graph::Edge<RouteWeight> edge;
+                edge.from = reader.Value<uint64_t>();
+                edge.to = reader.Value<uint64_t>();
+                const uint32_t bus_id = reader.Value<uint32_t>();
+                edge.weight.bus_name = bus_id == NO_BUS ? std::string_view{} : CheckedAt(refs.buses, bus_id);
+                edge.weight.total_time = reader.Value<double>();
+                edge.weight.span_count = reader.Value<int32_t>();
+                edge.weight.type = static_cast<EdgeType>(reader.Value<uint8_t>());
+                if (edge.from >= graph.GetVertexCount() || edge.to >= graph.GetVertexCount()) {
+                    throw SnapshotError("Snapshot edge refers to a missing vertex"s);
+                }
+                graph.AddEdge(edge);
+            }
+            return graph;
+        }
+
+        void SaveContractionHierarchy(Writer& writer, const ContractionHierarchy& hierarchy) {
+            const auto& arcs = hierarchy.GetArcs();
+            writer.Size(arcs.size());
+            for (const auto& arc : arcs) {
+                writer.Value(static_cast<uint64_t>(arc.from));
+                writer.Value(static_cast<uint64_t>(arc.to));
+                writer.Value(WeightTraits::ToValue(arc.weight));
+                writer.Value(static_cast<uint64_t>(arc.edge));
+                writer.Value(static_cast<uint64_t>(arc.first));
+                writer.Value(static_cast<uint64_t>(arc.second));
+            }
+            writer.Size(hierarchy.GetRanks().size());
+            for (const size_t rank : hierarchy.GetRanks()) {
+                writer.Size(rank);
+            }
+        }
+
+        ContractionHierarchy LoadContractionHierarchy(Reader& reader) {
+            std::vector<ContractionHierarchy::Arc> arcs(reader.Size());
+            for (auto& arc : arcs) {
+                arc.from = reader.Value<uint64_t>();
+                arc.to = reader.Value<uint64_t>();
+                arc.weight = WeightTraits::FromValue(reader.Value<WeightTraits::Value>());
+                arc.edge = reader.Value<uint64_t>();
+                arc.first = reader.Value<uint64_t>();
+                arc.second = reader.Value<uint64_t>();
+            }
+            std::vector<size_t> ranks(reader.Size());
+            for (size_t& rank : ranks) {
+                rank = reader.Size();
+            }
+            return ContractionHierarchy(std::move(arcs), std::move(ranks));
+        }
+
+        void SaveRouter(Writer& writer, const TransportRouter& router, const TransportCatalogue& catalogue) {
+            SaveRouterSettings(writer, router.GetRouterSettings());
+
+            const Router* graph_router = router.GetRouter();
+            writer.Value(static_cast<uint8_t>(graph_router != nullptr));
+            if (!graph_router) {
+                return;
+            }
+
+            writer.Size(router.GetStopVertexCount());
+            for (graph::VertexId vertex = 0; vertex < router.GetStopVertexCount(); ++vertex) {
+                writer.Value(router.GetVertexStop(vertex)->id);
+            }
+            SaveGraph(writer, router.GetGraph(), catalogue);
+
+            writer.Value(static_cast<uint8_t>(graph_router->GetMode()));
+            switch (graph_router->GetMode()) {
+            case graph::RouterMode::EAGER:
+                writer.Array(graph_router->GetRoutesInternalData().weights);
+                writer.Array(graph_router->GetRoutesInternalData().prev_edges);
+                break;
+            case graph::RouterMode::CONTRACTION_HIERARCHIES:
+                SaveContractionHierarchy(writer, *graph_router->GetContractionHierarchy());
+                break;
+            case graph::RouterMode::ON_DEMAND:
+                break;
+            }
+        }
+
+        void LoadRouter(Reader& reader, TransportRouter& router, const CatalogueRefs& refs) {
+            const RouterSettings settings = LoadRouterSettings(reader);
+            if (reader.Value<uint8_t>() == 0) {
+                router.SetRouterSetting(settings);
+                return;
+            }
+
+            std::vector<const Stop*> vertex_stops(reader.Size());
+            for (auto& stop : vertex_stops) {
+                stop = CheckedAt(refs.stops, reader.Value<uint32_t>());
+            }
+            router.RestoreGraph(settings, vertex_stops, LoadGraph(reader, refs));
+
+            const Graph& graph = router.GetGraph();
+            switch (static_cast<graph::RouterMode>(reader.Value<uint8_t>())) {
+            case graph::RouterMode::EAGER: {
+                Router::RoutesInternalData routes_internal_data;
+                routes_internal_data.vertex_count = graph.GetVertexCount();
+                routes_internal_data.weights = reader.Array<Router::WeightValue>();
+                routes_internal_data.prev_edges = reader.Array<uint32_t>();
+                router.RestoreRouter(std::make_unique<Router>(graph, std::move(routes_internal_data)));
+                break;
+            }
+            case graph::RouterMode::CONTRACTION_HIERARCHIES:
+                router.RestoreRouter(std::make_unique<Router>(graph, LoadContractionHierarchy(reader)));
+                break;
+            case graph::RouterMode::ON_DEMAND:
+                router.RestoreRouter(std::make_unique<Router>(graph, graph::RouterMode::ON_DEMAND));
+                break;
+            default:
+                throw SnapshotError("Unknown router mode"s);
+            }
+        }
+
+    } // namespace
+
+    void SaveBase(std::ostream& output, const TransportCatalogue& catalogue,
+                  const renderer::MapRenderer& renderer, const TransportRouter& router) {
+        Writer writer(output);
+        output.write(MAGIC.data(), MAGIC.size());
+        writer.Value(VERSION);
+
+        SaveCatalogue(writer, catalogue);
+        SaveRenderSettings(writer, renderer.GetRendererSettings());
+        SaveRouter(writer, router, catalogue);
+
+        if (!output) {
+            throw SnapshotError("Failed to write snapshot"s);
+        }
+    }
+
+    void LoadBase(std::istream& input, TransportCatalogue& catalogue,
+                  renderer::MapRenderer& renderer, TransportRouter& router) {
+        std::string magic(MAGIC.size(), '\0');
+        input.read(magic.data(), magic.size());
+        if (!input || magic != MAGIC) {
+            throw SnapshotError("Not a transport catalogue snapshot"s);
+        }
+        Reader reader(input);
+        if (const uint32_t version = reader.Value<uint32_t>(); version != VERSION) {
+            throw SnapshotError("Unsupported snapshot version "s + std::to_string(version));
+        }
+
+        const CatalogueRefs refs = LoadCatalogue(reader, catalogue);
+        renderer.SetRendererSettings(LoadRenderSettings(reader));
+        LoadRouter(reader, router, refs);
+    }
+
+} // namespace serialization
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "map_renderer.h"
+#include "transport_router.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace serialization {
+
+    struct SerializationSettings {
+        std::string file;
+        // Optional read-only catalogue for mapping, see MappedCatalogue. When set, process_requests
+        // and serve answer Stop and Bus lookups from it without loading file
+        std::string mapped_catalogue_file;
+    };
+
+    class SnapshotError : public std::runtime_error {
+    public:
+        using runtime_error::runtime_error;
+    };
+
+    // Binary snapshot: catalogue, render settings, routing settings, route graph and router data
+    void SaveBase(
+        std::ostream& output,
+        const transport_catalogue::TransportCatalogue& catalogue,
+        const renderer::MapRenderer& renderer,
+        const transport_router::TransportRouter& router
+    );
+
+    void LoadBase(
+        std::istream& input,
+        transport_catalogue::TransportCatalogue& catalogue,
+        renderer::MapRenderer& renderer,
+        transport_router::TransportRouter& router
+    );
+
+} // namespace serialization
@@ -0,0 +1,243 @@
+#include "server.h"
+
+#include "json.h"
+#include "json_reader.h"
+#include "request_handler.h"
+
+#include <cerrno>
+#include <chrono>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace server {
+
+    namespace {
+#ifdef MSG_NOSIGNAL
+        constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+        constexpr int SEND_FLAGS = 0;
+#endif
+        constexpr size_t READ_CHUNK = 1 << 16;
+        constexpr int LISTEN_BACKLOG = 64;
+        // Pause after an accept error that retrying right away would not fix, out of descriptors for one
+        constexpr std::chrono::milliseconds ACCEPT_BACKOFF{ 100 };
+
+        std::unique_ptr<thread_pool::ThreadPool> CreateStatPool(size_t thread_count) {
+            if (thread_count == 1) {
+                return nullptr;
+            }
+            return std::make_unique<thread_pool::ThreadPool>(thread_count);
+        }
+
+#ifndef _WIN32
+        bool SendAll(int fd, std::string_view data) {
+            while (!data.empty()) {
+                const ssize_t sent = send(fd, data.data(), data.size(), SEND_FLAGS);
+                if (sent <= 0) {
+                    return false;
+                }
+                data.remove_prefix(static_cast<size_t>(sent));
+            }
+            return true;
+        }
+#endif
+    } // namespace
+
+    Server::Server(
+        const transport_catalogue::TransportCatalogue& catalogue,
+        const transport_router::TransportRouter& router,
+        const renderer::MapRenderer& renderer,
+        ServerSettings settings
+    ) :
+        catalogue_(catalogue),
+        router_(router),
+        renderer_(renderer),
+        settings_(std::move(settings)),
+        stat_pool_(CreateStatPool(settings_.stat_threads))
+    {}
+
+    Server::Server(
+        const transport_catalogue::MappedCatalogue& mapped,
+        const transport_catalogue::TransportCatalogue& catalogue,
+        const transport_router::TransportRouter& router,
+        const renderer::MapRenderer& renderer,
+        std::function<void()> load_base,
+        ServerSettings settings
+    ) :
+        catalogue_(catalogue),
+        router_(router),
+        renderer_(renderer),
+        settings_(std::move(settings)),
+        mapped_(&mapped),
+        load_base_(std::move(load_base)),
+        stat_pool_(CreateStatPool(settings_.stat_threads))
+    {}
+
+    Server::~Server() {
+        Stop();
+        for (auto& client : clients_) {
+            client.thread.join();
+        }
+    }
+
+    void Server::Run() {
+#ifdef _WIN32
+        throw ServerError("server mode needs Unix domain sockets");
+#else
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (settings_.socket.empty() || settings_.socket.size() >= sizeof(address.sun_path)) {
+            throw ServerError("invalid socket path: " + settings_.socket);
+        }
+        settings_.socket.copy(address.sun_path, settings_.socket.size());
+
+        // A socket file left by a previous run would make bind fail, anything else is not ours to delete
+        struct stat existing;
+        if (lstat(settings_.socket.c_str(), &existing) == 0) {
+            if (!S_ISSOCK(existing.st_mode)) {
+                throw ServerError(settings_.socket + " exists and is not a socket");
+            }
+            unlink(settings_.socket.c_str());
+        }
+
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd_ < 0) {
+            throw ServerError("cannot create socket");
+        }
+        if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+            || listen(listen_fd_, LISTEN_BACKLOG) != 0) {
+            close(listen_fd_);
+            listen_fd_ = -1;
+            throw ServerError("cannot listen on " + settings_.socket);
+        }
+
+        while (!stopping_) {
+            const int client_fd = accept(listen_fd_, nullptr, nullptr);
+            if (client_fd < 0) {
+                if (errno != EINTR && errno != ECONNABORTED && !stopping_) {
+                    std::this_thread::sleep_for(ACCEPT_BACKOFF);
+                }
+                continue;
+            }
+            std::lock_guard lock(clients_mutex_);
+            ReapClients();
+            Client& client = clients_.emplace_back();
+            client.thread = std::thread([this, client_fd, &client] {
+                ServeClient(client_fd);
+                client.done = true;
+            });
+        }
+
+        close(listen_fd_);
+        listen_fd_ = -1;
+        unlink(settings_.socket.c_str());
+#endif
+    }
+
+    void Server::Stop() {
+        stopping_ = true;
+#ifndef _WIN32
+        if (listen_fd_ >= 0) {
+            // Wakes up the blocked accept()
+            shutdown(listen_fd_, SHUT_RDWR);
+        }
+#endif
+    }
+
+    void Server::ReapClients() {
+        for (auto it = clients_.begin(); it != clients_.end();) {
+            if (it->done) {
+                it->thread.join();
+                it = clients_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    void Server::ServeClient(int client_fd) const {
+#ifndef _WIN32
+        std::string pending;
+        // pending holds no newline before this offset, a batch arriving in many chunks is scanned once
+        size_t scanned = 0;
+        char chunk[READ_CHUNK];
+        bool connected = true;
+        while (connected && !stopping_) {
+            const ssize_t received = recv(client_fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                break;
+            }
+            pending.append(chunk, static_cast<size_t>(received));
+
+            size_t line_begin = 0;
+            for (size_t line_end = pending.find('\n', scanned); line_end != std::string::npos;
+                line_end = pending.find('\n', line_begin)) {
+                const std::string batch = pending.substr(line_begin, line_end - line_begin);
+                line_begin = line_end + 1;
+                if (batch.find_first_not_of(" \t\r") == std::string::npos) {
+                    continue;
+                }
+                if (!SendAll(client_fd, AnswerBatch(batch))) {
+                    connected = false;
+                    break;
+                }
+            }
+            pending.erase(0, line_begin);
+            scanned = pending.size();
+        }
+        close(client_fd);
+#endif
+    }
+
+    void Server::LoadBase() const {
+        std::call_once(base_loaded_, [this] {
+            try {
+                load_base_();
+            }
+            catch (const std::exception& e) {
+                // The base may be half filled, so it is not loaded again
+                base_error_ = e.what();
+            }
+        });
+        if (!base_error_.empty()) {
+            throw ServerError(base_error_);
+        }
+    }
+
+    std::string Server::AnswerBatch(const std::string& batch) const {
+        std::ostringstream output;
+        try {
+            std::istringstream input(batch);
+            json_reader::JsonReader requests(input);
+            if (mapped_ && request_handler::MappedRequestHandler::CanAnswer(requests.GetStatRequests().AsArray())) {
+                request_handler::MappedRequestHandler handler(requests, *mapped_);
+                handler.ProcessRequests(output, json::Format::COMPACT);
+            }
+            else {
+                if (load_base_) {
+                    LoadBase();
+                }
+                request_handler::RequestHandler handler(requests, catalogue_, router_, renderer_, stat_pool_.get());
+                handler.ProcessRequests(output, json::Format::COMPACT);
+            }
+        }
+        catch (const std::exception& e) {
+            // A broken batch is reported to its client and the connection stays open
+            output.str({});
+            json::Writer writer(output, json::Format::COMPACT);
+            writer.StartDict()
+                .Key("error_message").Value(e.what())
+                .EndDict();
+        }
+        output << '\n';
+        return output.str();
+    }
+
+} // namespace server
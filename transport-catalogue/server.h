@@ -0,0 +1,92 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+#include "map_renderer.h"
+#include "mapped_catalogue.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace server {
+
+    struct ServerSettings {
+        std::string socket;
+        // Threads answering a batch, one pool shared by all clients; 0 - one per hardware core
+        size_t stat_threads = 1;
+    };
+
+    class ServerError : public std::runtime_error {
+    public:
+        using runtime_error::runtime_error;
+    };
+
+    // Answers stat_requests from a resident catalogue over a Unix domain socket.
+    // Every line a client sends is one JSON document with stat_requests, the answer is
+    // the compact response array on one line. Each client is served by its own thread.
+    class Server {
+    public:
+        Server(
+            const transport_catalogue::TransportCatalogue& catalogue,
+            const transport_router::TransportRouter& router,
+            const renderer::MapRenderer& renderer,
+            ServerSettings settings
+        );
+        // Stop and Bus batches are answered from the mapped catalogue. catalogue, router and
+        // renderer start out empty, load_base fills them in for the first batch needing more.
+        Server(
+            const transport_catalogue::MappedCatalogue& mapped,
+            const transport_catalogue::TransportCatalogue& catalogue,
+            const transport_router::TransportRouter& router,
+            const renderer::MapRenderer& renderer,
+            std::function<void()> load_base,
+            ServerSettings settings
+        );
+        ~Server();
+
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        // Accepts clients until Stop() is called
+        void Run();
+        void Stop();
+
+    private:
+        const transport_catalogue::TransportCatalogue& catalogue_;
+        const transport_router::TransportRouter& router_;
+        const renderer::MapRenderer& renderer_;
+        ServerSettings settings_;
+        const transport_catalogue::MappedCatalogue* mapped_ = nullptr;
+        std::function<void()> load_base_;
+        // Clients' own stat_settings.threads are ignored, so no client can make the server start threads
+        std::unique_ptr<thread_pool::ThreadPool> stat_pool_;
+        mutable std::once_flag base_loaded_;
+        mutable std::string base_error_;
+
+        struct Client {
+            std::thread thread;
+            std::atomic<bool> done = false;
+        };
+
+        int listen_fd_ = -1;
+        std::atomic<bool> stopping_ = false;
+        std::mutex clients_mutex_;
+        // Stable addresses, every thread marks its own Client done
+        std::list<Client> clients_;
+
+        void ServeClient(int client_fd) const;
+        // Joins the threads of clients that have disconnected
+        void ReapClients();
+        // Runs load_base once, a failure is reported to every batch that needs the base
+        void LoadBase() const;
+        std::string AnswerBatch(const std::string& batch) const;
+    };
+
+} // namespace server
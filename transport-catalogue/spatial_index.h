@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace spatial_index {
+
+    // Static k-d tree over points in Dims-dimensional space, each carrying a Value.
+    // The tree is implicit: the median of every range sits in its middle, the two halves
+    // on either side, and the split axis cycles with depth. No per-node allocations.
+    template <size_t Dims, typename Value>
+    class KdTree {
+    public:
+        using Point = std::array<double, Dims>;
+
+        struct Entry {
+            Point point;
+            Value value;
+        };
+
+        KdTree() = default;
+
+        explicit KdTree(std::vector<Entry> entries)
+            : entries_(std::move(entries))
+        {
+            Build(0, entries_.size(), 0);
+        }
+
+        size_t Size() const {
+            return entries_.size();
+        }
+
+        // Calls visitor(entry) for every entry with lower[d] <= point[d] <= upper[d] in all dimensions
+        template <typename Visitor>
+        void VisitBox(const Point& lower, const Point& upper, Visitor&& visitor) const {
+            VisitBox(0, entries_.size(), 0, lower, upper, visitor);
+        }
+
+        // Up to count entries nearest to the point by Euclidean distance, nearest first
+        std::vector<const Entry*> FindNearest(const Point& point, size_t count) const {
+            std::vector<const Entry*> result;
+            if (count == 0) {
+                return result;
+            }
+            Candidates candidates;
+            FindNearest(0, entries_.size(), 0, point, count, candidates);
+
+            result.resize(candidates.size());
+            for (auto it = result.rbegin(); it != result.rend(); ++it) {
+                *it = &entries_[candidates.top().second];
+                candidates.pop();
+            }
+            return result;
+        }
+
+    private:
+        // Max-heap of (squared distance, entry index), the farthest candidate on top
+        using Candidates = std::priority_queue<std::pair<double, size_t>>;
+
+        std::vector<Entry> entries_;
+
+        void Build(size_t begin, size_t end, size_t axis) {
+            if (end - begin < 2) {
+                return;
+            }
+            const size_t middle = begin + (end - begin) / 2;
+            std::nth_element(entries_.begin() + begin, entries_.begin() + middle, entries_.begin() + end,
+                [axis](const Entry& lhs, const Entry& rhs) { return lhs.point[axis] < rhs.point[axis]; });
+            const size_t next_axis = (axis + 1) % Dims;
+            Build(begin, middle, next_axis);
+            Build(middle + 1, end, next_axis);
+        }
+
+        template <typename Visitor>
+        void VisitBox(size_t begin, size_t end, size_t axis, const Point& lower, const Point& upper, Visitor& visitor) const {
+            if (begin == end) {
+                return;
+            }
+            const size_t middle = begin + (end - begin) / 2;
+            const Entry& entry = entries_[middle];
+            bool inside = true;
+            for (size_t d = 0; d < Dims; ++d) {
+                inside = inside && lower[d] <= entry.point[d] && entry.point[d] <= upper[d];
+            }
+            if (inside) {
+                visitor(entry);
+            }
+
+            const size_t next_axis = (axis + 1) % Dims;
+            if (lower[axis] <= entry.point[axis]) {
+                VisitBox(begin, middle, next_axis, lower, upper, visitor);
+            }
+            if (entry.point[axis] <= upper[axis]) {
+                VisitBox(middle + 1, end, next_axis, lower, upper, visitor);
+            }
+        }
+
+        void FindNearest(size_t begin, size_t end, size_t axis, const Point& point, size_t count, Candidates& candidates) const {
+            if (begin == end) {
+                return;
+            }
+            const size_t middle = begin + (end - begin) / 2;
+            const Entry& entry = entries_[middle];
+            double distance = 0;
+            for (size_t d = 0; d < Dims; ++d) {
+                distance += (entry.point[d] - point[d]) * (entry.point[d] - point[d]);
+            }
+            if (candidates.size() < count) {
+                candidates.emplace(distance, middle);
+            }
+            else if (distance < candidates.top().first) {
+                candidates.pop();
+                candidates.emplace(distance, middle);
+            }
+
+            // The side holding the point first, the other one only if it can still be closer
+            const double offset = point[axis] - entry.point[axis];
+            const size_t next_axis = (axis + 1) % Dims;
+            const auto [near_begin, near_end] = offset < 0 ? std::pair(begin, middle) : std::pair(middle + 1, end);
+            const auto [far_begin, far_end] = offset < 0 ? std::pair(middle + 1, end) : std::pair(begin, middle);
+            FindNearest(near_begin, near_end, next_axis, point, count, candidates);
+            if (candidates.size() < count || offset * offset < candidates.top().first) {
+                FindNearest(far_begin, far_end, next_axis, point, count, candidates);
+            }
+        }
+    };
+
+} // namespace spatial_index
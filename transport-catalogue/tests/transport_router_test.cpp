@@ -0,0 +1,102 @@
+// Build from transport-catalogue/:
+// g++ -std=c++17 -pthread -I. tests/transport_router_test.cpp transport_router.cpp transport_catalogue.cpp geo.cpp thread_pool.cpp
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+using namespace transport_catalogue;
+using namespace transport_router;
+
+namespace {
+	// A line bus and a ring bus meeting at one stop, so every route is unique. The odd distances
+	// and velocity make the ride times long decimals, where the two models used to round apart.
+	void FillCatalogue(TransportCatalogue& catalogue) {
+		for (int i = 0; i < 10; ++i) {
+			catalogue.AddStop("Stop "s + std::to_string(i), { 55.6 + i * 0.01, 37.6 + i * 0.013 });
+		}
+		auto stop = [&catalogue](int i) { return catalogue.FindStop("Stop "s + std::to_string(i)); };
+
+		const std::vector<int> line = { 0, 1, 2, 3, 4, 5 };
+		const std::vector<int> ring = { 2, 6, 7, 8, 9, 2 };
+		const int distances[] = { 1111, 2333, 1777, 3019, 947, 2213, 1409, 2851, 1033, 3797 };
+		std::vector<const Stop*> line_stops;
+		for (size_t i = 0; i < line.size(); ++i) {
+			line_stops.push_back(stop(line[i]));
+			if (i > 0) {
+				catalogue.SetDistance({ stop(line[i - 1]), stop(line[i]) }, distances[i]);
+				catalogue.SetDistance({ stop(line[i]), stop(line[i - 1]) }, distances[i] + 101);
+			}
+		}
+		std::vector<const Stop*> ring_stops;
+		for (size_t i = 0; i < ring.size(); ++i) {
+			ring_stops.push_back(stop(ring[i]));
+			if (i > 0) {
+				catalogue.SetDistance({ stop(ring[i - 1]), stop(ring[i]) }, distances[ring[i]] + 17);
+			}
+		}
+		catalogue.AddRoute("14"s, line_stops, false);
+		catalogue.AddRoute("297"s, ring_stops, true);
+	}
+
+	void TestTransferModelPrintsDirectItems() {
+		TransportCatalogue catalogue;
+		FillCatalogue(catalogue);
+
+		RouterSettings settings;
+		settings.bus_wait_time = 6;
+		settings.bus_velocity = 37;
+		const TransportRouter direct(catalogue, settings);
+		settings.graph_model = GraphModel::TRANSFER;
+		const TransportRouter transfer(catalogue, settings);
+
+		for (const auto& [from_name, from] : catalogue.GetStops()) {
+			for (const auto& [to_name, to] : catalogue.GetStops()) {
+				const auto expected = direct.BuildRouteData(from, to);
+				const auto actual = transfer.BuildRouteData(from, to);
+				assert(expected && actual);
+				assert(std::abs(expected->total_time - actual->total_time) < 1e-9);
+				assert(expected->items.size() == actual->items.size());
+				for (size_t i = 0; i < expected->items.size(); ++i) {
+					const RouteItem& lhs = expected->items[i];
+					const RouteItem& rhs = actual->items[i];
+					assert(lhs.type == rhs.type);
+					assert(lhs.name == rhs.name);
+					// Exactly equal, not just close: the printed digits must not differ
+					assert(lhs.time == rhs.time);
+					assert(lhs.span_count == rhs.span_count);
+				}
+			}
+		}
+	}
+
+	void TestIsochroneBudget() {
+		TransportCatalogue catalogue;
+		FillCatalogue(catalogue);
+
+		RouterSettings settings;
+		settings.bus_wait_time = 6;
+		settings.bus_velocity = 37;
+		for (const auto mode : { graph::RouterMode::EAGER, graph::RouterMode::ON_DEMAND, graph::RouterMode::CONTRACTION_HIERARCHIES }) {
+			settings.router_mode = mode;
+			const TransportRouter router(catalogue, settings);
+			const Stop* origin = catalogue.FindStop("Stop 0"s);
+
+			// A zero budget reaches only the origin, a negative one nothing at all
+			const auto at_origin = router.BuildIsochrone(origin, 0);
+			assert(at_origin.size() == 1 && at_origin[0].stop == origin && at_origin[0].time == 0);
+			assert(router.BuildIsochrone(origin, -1).empty());
+		}
+	}
+} // namespace
+
+int main() {
+	TestTransferModelPrintsDirectItems();
+	TestIsochroneBudget();
+	std::cout << "transport_router_test OK"s << std::endl;
+}
@@ -0,0 +1,158 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace thread_pool {
+
+    namespace {
+        thread_local bool running_task = false;
+    } // namespace
+
+    ThreadPool::ThreadPool(size_t thread_count) {
+        if (thread_count == 0) {
+            thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < thread_count; ++i) {
+            blocks_.push_back(std::make_unique<Block>());
+        }
+        workers_.reserve(thread_count - 1);
+        for (size_t i = 0; i + 1 < thread_count; ++i) {
+            workers_.emplace_back([this, i] { WorkerLoop(i); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        start_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    size_t ThreadPool::GetThreadCount() const {
+        return blocks_.size();
+    }
+
+    bool ThreadPool::IsRunningTask() {
+        return running_task;
+    }
+
+    void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task) {
+        std::lock_guard loop_lock(loop_mutex_);
+
+        const size_t participants = blocks_.size();
+        for (size_t i = 0; i < participants; ++i) {
+            std::lock_guard block_lock(blocks_[i]->mutex);
+            blocks_[i]->begin = count * i / participants;
+            blocks_[i]->end = count * (i + 1) / participants;
+        }
+
+        {
+            std::lock_guard lock(mutex_);
+            task_ = &task;
+            exception_ = nullptr;
+            busy_workers_ = workers_.size();
+            ++generation_;
+        }
+        start_.notify_all();
+
+        RunTasks(participants - 1);
+
+        std::unique_lock lock(mutex_);
+        done_.wait(lock, [this] { return busy_workers_ == 0; });
+        task_ = nullptr;
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+    }
+
+    void ThreadPool::WorkerLoop(size_t participant) {
+        size_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock lock(mutex_);
+                start_.wait(lock, [this, seen_generation] { return stopping_ || generation_ != seen_generation; });
+                if (stopping_) {
+                    return;
+                }
+                seen_generation = generation_;
+            }
+
+            RunTasks(participant);
+
+            {
+                std::lock_guard lock(mutex_);
+                --busy_workers_;
+            }
+            done_.notify_one();
+        }
+    }
+
+    void ThreadPool::RunTasks(size_t participant) {
+        // A task may run a loop of another pool, so the flag is restored rather than cleared
+        const bool was_running_task = running_task;
+        running_task = true;
+        size_t index = 0;
+        while (TakeTask(participant, index) || (Steal(participant) && TakeTask(participant, index))) {
+            try {
+                (*task_)(index);
+            }
+            catch (...) {
+                std::lock_guard lock(mutex_);
+                if (!exception_) {
+                    exception_ = std::current_exception();
+                }
+            }
+        }
+        running_task = was_running_task;
+    }
+
+    bool ThreadPool::TakeTask(size_t participant, size_t& index) {
+        Block& block = *blocks_[participant];
+        std::lock_guard lock(block.mutex);
+        if (block.begin == block.end) {
+            return false;
+        }
+        index = block.begin++;
+        return true;
+    }
+
+    bool ThreadPool::Steal(size_t participant) {
+        while (true) {
+            size_t victim = participant;
+            size_t largest = 0;
+            for (size_t i = 0; i < blocks_.size(); ++i) {
+                if (i == participant) {
+                    continue;
+                }
+                std::lock_guard lock(blocks_[i]->mutex);
+                if (blocks_[i]->end - blocks_[i]->begin > largest) {
+                    largest = blocks_[i]->end - blocks_[i]->begin;
+                    victim = i;
+                }
+            }
+            if (largest == 0) {
+                return false;
+            }
+
+            Block& own = *blocks_[participant];
+            Block& other = *blocks_[victim];
+            // scoped_lock keeps two thieves robbing each other from deadlocking
+            std::scoped_lock lock(own.mutex, other.mutex);
+            const size_t left = other.end - other.begin;
+            if (left == 0) {
+                // Drained while we were looking, try another one
+                continue;
+            }
+            const size_t stolen = (left + 1) / 2;
+            own.begin = other.end - stolen;
+            own.end = other.end;
+            other.end -= stolen;
+            return true;
+        }
+    }
+
+} // namespace thread_pool
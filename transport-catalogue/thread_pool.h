@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace thread_pool {
+
+    // Fixed set of worker threads for index-parallel loops. Each participant takes tasks from the
+    // front of its own block of indices and, once that is empty, steals half of the largest block left.
+    class ThreadPool {
+    public:
+        // 0 means one thread per hardware core; the calling thread counts as one of them
+        explicit ThreadPool(size_t thread_count = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t GetThreadCount() const;
+
+        // True while the calling thread runs a ParallelFor task of any pool. A loop started
+        // from there would put more threads on cores that are already busy.
+        static bool IsRunningTask();
+
+        // Runs task(i) for every i in [0, count) and returns when all of them are done.
+        // The first exception thrown by a task is rethrown here.
+        void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    private:
+        struct Block {
+            std::mutex mutex;
+            size_t begin = 0;
+            size_t end = 0;
+        };
+
+        std::vector<std::thread> workers_;
+        // One block per participant, the last one belongs to the calling thread
+        std::vector<std::unique_ptr<Block>> blocks_;
+
+        std::mutex mutex_;
+        std::condition_variable start_;
+        std::condition_variable done_;
+        size_t generation_ = 0;
+        size_t busy_workers_ = 0;
+        bool stopping_ = false;
+        const std::function<void(size_t)>* task_ = nullptr;
+        std::exception_ptr exception_;
+
+        // Only one loop runs at a time
+        std::mutex loop_mutex_;
+
+        void WorkerLoop(size_t participant);
+        void RunTasks(size_t participant);
+        bool TakeTask(size_t participant, size_t& index);
+        bool Steal(size_t participant);
+    };
+
+} // namespace thread_pool
@@ -1,44 +1,84 @@
 #include "transport_catalogue.h"
 
+#include <algorithm>
+#include <numeric>
+
 namespace transport_catalogue {
+	namespace {
+		std::array<double, 3> ToUnitSphere(const geo::PreparedCoordinates& coordinates) {
+			return { coordinates.cos_lat * coordinates.cos_lng, coordinates.cos_lat * coordinates.sin_lng, coordinates.sin_lat };
+		}
+	} // namespace
+
 	void TransportCatalogue::AddStop(const std::string& name, geo::Coordinates coordinates) {
-		stops_.push_back({ name, coordinates, {} });
+		stops_.push_back({ name, coordinates, geo::Prepare(coordinates), {}, static_cast<StopId>(stops_.size()) });
 		stops_as_catalogue_.insert({ stops_.back().name, &stops_.back() });
+		stops_changed_ = true;
 	}
 
 	void TransportCatalogue::AddRoute(const std::string& number, const std::vector<const Stop*>& stops, bool is_roundtrip) {
-		buses_.push_back({ number, stops, is_roundtrip });
+		buses_.push_back({ number, stops, is_roundtrip, static_cast<BusId>(buses_.size()) });
 		buses_as_catalogue_.insert({ buses_.back().number, &buses_.back() });
 
+		const Bus& bus = buses_.back();
 		for (const auto& stop : stops) {
-			stops_as_catalogue_.at(stop->name)->buses.insert(number);
+			std::vector<BusId>& stop_buses = stops_[stop->id].buses;
+			const auto it = std::lower_bound(stop_buses.begin(), stop_buses.end(), bus.number,
+				[this](BusId id, const std::string& number) { return buses_[id].number < number; });
+			if (it == stop_buses.end() || *it != bus.id) {
+				stop_buses.insert(it, bus.id);
+			}
 		}
+		bus_infos_.insert({ bus.number, ComputeBusInfo(bus) });
 	}
 
 	const Stop* TransportCatalogue::FindStop(std::string_view stop) const {
-		return stops_as_catalogue_.count(stop) ? stops_as_catalogue_.at(stop) : nullptr;
+		const auto it = stops_as_catalogue_.find(stop);
+		return it != stops_as_catalogue_.end() ? it->second : nullptr;
 	}
 
 	const Bus* TransportCatalogue::FindRoute(std::string_view bus) const {
-		return buses_as_catalogue_.count(bus) ? buses_as_catalogue_.at(bus) : nullptr;
+		const auto it = buses_as_catalogue_.find(bus);
+		return it != buses_as_catalogue_.end() ? it->second : nullptr;
+	}
+
+	const Stop* TransportCatalogue::GetStop(StopId id) const {
+		return &stops_.at(id);
+	}
+
+	const Bus* TransportCatalogue::GetBus(BusId id) const {
+		return &buses_.at(id);
+	}
+
+	size_t TransportCatalogue::GetStopCount() const {
+		return stops_.size();
 	}
 
+	size_t TransportCatalogue::GetBusCount() const {
+		return buses_.size();
+	}
 
 	void TransportCatalogue::SetDistance(const std::pair<const Stop*, const Stop*>& stops,
 		int distance) {
-		distances_[stops] = distance;
+		pending_distances_.push_back({ stops.first->id, stops.second->id, distance });
+		distances_changed_ = true;
 	}
 
 	double TransportCatalogue::GetDistance(const Stop* from, const Stop* to) const {
-		if (distances_.count({ from, to })) {
-			return distances_.at({ from, to });
-		}
+		const DistanceRange row = GetDistancesFrom(from);
+		const auto it = std::lower_bound(row.begin(), row.end(), to->id, [](const RoadDistance& entry, StopId id) {
+			return entry.to < id;
+			});
+		return it != row.end() && it->to == to->id ? it->distance : 0;
+	}
 
-		if (distances_.count({ to, from })) {
-			return distances_.at({ to, from });
+	TransportCatalogue::DistanceRange TransportCatalogue::GetDistancesFrom(const Stop* stop) const {
+		UpdateDistanceTable();
+		if (stop->id + 1 >= distance_offsets_.size()) {
+			return { nullptr, nullptr };
 		}
-
-		return 0;
+		const RoadDistance* row = distances_.data();
+		return { row + distance_offsets_[stop->id], row + distance_offsets_[stop->id + 1] };
 	}
 
 	const std::unordered_map<std::string_view, Bus*>& TransportCatalogue::GetBuses() const {
@@ -49,12 +89,164 @@ namespace transport_catalogue {
 		return stops_as_catalogue_;
 	}
 
-	size_t TransportCatalogue::UniqueStopsCount(const std::string& bus) const {
-		std::unordered_set<std::string_view> unique_stops;
-		for (const auto& stop : buses_as_catalogue_.at(bus)->stops) {
-			unique_stops.insert(stop->name);
+	const BusInfo* TransportCatalogue::GetBusInfo(std::string_view bus) const {
+		const auto it = bus_infos_.find(bus);
+		return it != bus_infos_.end() ? &it->second : nullptr;
+	}
+
+	std::vector<NearbyStop> TransportCatalogue::FindNearestStops(geo::Coordinates point, size_t count) const {
+		UpdateStopIndex();
+		std::vector<NearbyStop> result;
+		for (const auto* entry : stops_on_sphere_.FindNearest(ToUnitSphere(geo::Prepare(point)), count)) {
+			const Stop* stop = &stops_[entry->value];
+			result.push_back({ stop, geo::ComputeDistance(point, stop->coordinates) });
+		}
+		return result;
+	}
+
+	std::vector<const Stop*> TransportCatalogue::FindStopsInBox(geo::Coordinates min, geo::Coordinates max) const {
+		UpdateStopIndex();
+		std::vector<const Stop*> result;
+		auto add_stop = [this, &result](const auto& entry) {
+			result.push_back(&stops_[entry.value]);
+		};
+		if (min.lng <= max.lng) {
+			stops_on_map_.VisitBox({ min.lat, min.lng }, { max.lat, max.lng }, add_stop);
+		}
+		else {
+			stops_on_map_.VisitBox({ min.lat, min.lng }, { max.lat, 180.0 }, add_stop);
+			stops_on_map_.VisitBox({ min.lat, -180.0 }, { max.lat, max.lng }, add_stop);
+		}
+		std::sort(result.begin(), result.end(), [](const Stop* lhs, const Stop* rhs) {
+			return lhs->name < rhs->name;
+			});
+		return result;
+	}
+
+	void TransportCatalogue::UpdateStopIndex() const {
+		if (!stops_changed_.load(std::memory_order_acquire)) {
+			return;
+		}
+		std::lock_guard lock(stop_index_mutex_);
+		if (!stops_changed_.load(std::memory_order_relaxed)) {
+			return;
 		}
-		return unique_stops.size();
+
+		std::vector<spatial_index::KdTree<3, StopId>::Entry> sphere_entries;
+		std::vector<spatial_index::KdTree<2, StopId>::Entry> map_entries;
+		sphere_entries.reserve(stops_.size());
+		map_entries.reserve(stops_.size());
+		for (const Stop& stop : stops_) {
+			sphere_entries.push_back({ ToUnitSphere(stop.prepared_coordinates), stop.id });
+			map_entries.push_back({ { stop.coordinates.lat, stop.coordinates.lng }, stop.id });
+		}
+		stops_on_sphere_ = spatial_index::KdTree<3, StopId>(std::move(sphere_entries));
+		stops_on_map_ = spatial_index::KdTree<2, StopId>(std::move(map_entries));
+		stops_changed_.store(false, std::memory_order_release);
+	}
+
+	void TransportCatalogue::UpdateDistanceTable() const {
+		if (!distances_changed_.load(std::memory_order_acquire)) {
+			return;
+		}
+		std::lock_guard lock(distances_mutex_);
+		if (distances_changed_.load(std::memory_order_relaxed)) {
+			RebuildDistanceTable();
+			distances_changed_.store(false, std::memory_order_release);
+		}
+	}
+
+	void TransportCatalogue::RebuildDistanceTable() const {
+		std::vector<DistanceEntry> entries;
+		entries.reserve((distances_.size() + pending_distances_.size()) * 2);
+		for (StopId from = 0; from + 1 < distance_offsets_.size(); ++from) {
+			for (uint32_t i = distance_offsets_[from]; i < distance_offsets_[from + 1]; ++i) {
+				if (!mirrored_distances_[i]) {
+					entries.push_back({ from, distances_[i].to, distances_[i].distance });
+				}
+			}
+		}
+		entries.insert(entries.end(), pending_distances_.begin(), pending_distances_.end());
+		pending_distances_.clear();
+		pending_distances_.shrink_to_fit();
+
+		auto by_stops = [](const DistanceEntry& lhs, const DistanceEntry& rhs) {
+			return std::pair(lhs.from, lhs.to) < std::pair(rhs.from, rhs.to);
+		};
+		// A distance set again replaces the earlier one
+		std::stable_sort(entries.begin(), entries.end(), by_stops);
+		size_t set_count = 0;
+		for (const DistanceEntry& entry : entries) {
+			if (set_count > 0 && entries[set_count - 1].from == entry.from && entries[set_count - 1].to == entry.to) {
+				entries[set_count - 1] = entry;
+			}
+			else {
+				entries[set_count++] = entry;
+			}
+		}
+		entries.resize(set_count);
+
+		// Directions that have no distance of their own fall back to the opposite one
+		for (size_t i = 0; i < set_count; ++i) {
+			const DistanceEntry reverse{ entries[i].to, entries[i].from, entries[i].distance };
+			if (!std::binary_search(entries.begin(), entries.begin() + set_count, reverse, by_stops)) {
+				entries.push_back(reverse);
+			}
+		}
+		std::vector<bool> mirrored(entries.size(), false);
+		std::fill(mirrored.begin() + set_count, mirrored.end(), true);
+
+		std::vector<uint32_t> order(entries.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&entries, &by_stops](uint32_t lhs, uint32_t rhs) {
+			return by_stops(entries[lhs], entries[rhs]);
+			});
+
+		distance_offsets_.assign(stops_.size() + 1, 0);
+		distances_.clear();
+		distances_.reserve(entries.size());
+		mirrored_distances_.clear();
+		mirrored_distances_.reserve(entries.size());
+		for (uint32_t index : order) {
+			++distance_offsets_[entries[index].from + 1];
+			distances_.push_back({ entries[index].to, entries[index].distance });
+			mirrored_distances_.push_back(mirrored[index]);
+		}
+		for (size_t i = 1; i < distance_offsets_.size(); ++i) {
+			distance_offsets_[i] += distance_offsets_[i - 1];
+		}
+		distances_.shrink_to_fit();
+	}
+
+	BusInfo TransportCatalogue::ComputeBusInfo(const Bus& bus) const {
+		BusInfo bus_info;
+		std::unordered_set<const Stop*> unique_stops;
+		std::vector<geo::PreparedCoordinates> points;
+		points.reserve(bus.stops.size());
+		for (size_t i = 0; i < bus.stops.size(); ++i) {
+			unique_stops.insert(bus.stops[i]);
+			points.push_back(bus.stops[i]->prepared_coordinates);
+			if (i + 1 == bus.stops.size()) {
+				break;
+			}
+			const Stop* from = bus.stops[i];
+			const Stop* to = bus.stops[i + 1];
+			if (bus.is_roundtrip) {
+				bus_info.route_length += GetDistance(from, to);
+			}
+			else {
+				bus_info.route_length += GetDistance(from, to) + GetDistance(to, from);
+			}
+		}
+		bus_info.geo_route_length = geo::ComputePathLength(points.data(), points.size());
+		if (!bus.is_roundtrip) {
+			bus_info.geo_route_length *= 2;
+		}
+
+		bus_info.curvature = bus_info.route_length / bus_info.geo_route_length;
+		bus_info.stops_count = bus.is_roundtrip ? bus.stops.size() : bus.stops.size() * 2 - 1;
+		bus_info.unique_stops_count = unique_stops.size();
+		return bus_info;
 	}
 
 } //namespace catalogue
\ No newline at end of file
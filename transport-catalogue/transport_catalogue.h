@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <deque>
+#include <mutex>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -11,24 +13,43 @@
 
 #include "geo.h"
 #include "domain.h"
+#include "ranges.h"
+#include "spatial_index.h"
 
 namespace transport_catalogue {
 
 	class TransportCatalogue {
 	public:
+		using DistanceRange = ranges::Range<const RoadDistance*>;
+
 		void AddStop(const std::string& name, geo::Coordinates coordinates);
 		void AddRoute(const std::string& number, const std::vector<const Stop*>& stops, bool is_roundtrip);
 
 		const Stop* FindStop(std::string_view stop) const;
 		const Bus* FindRoute(std::string_view bus) const;
+		const Stop* GetStop(StopId id) const;
+		const Bus* GetBus(BusId id) const;
+		size_t GetStopCount() const;
+		size_t GetBusCount() const;
 
+		// A distance not set in the asked direction is taken from the opposite one, 0 if neither is set
 		double GetDistance(const Stop* a, const Stop* b) const;
 		void SetDistance(const std::pair<const Stop*, const Stop*>& stops, int distance);
+		// Distances from the stop ordered by target id, the opposite-direction fallbacks included
+		DistanceRange GetDistancesFrom(const Stop* stop) const;
 
 		const std::unordered_map<std::string_view, Bus*>& GetBuses() const;
 		const std::unordered_map<std::string_view, Stop*>& GetStops() const;
 
-		size_t UniqueStopsCount(const std::string& bus) const;
+		// Statistics are computed once in AddRoute, so distances between the stops of a bus
+		// have to be set before the bus is added
+		const BusInfo* GetBusInfo(std::string_view bus) const;
+
+		// Up to count stops closest to the point, nearest first
+		std::vector<NearbyStop> FindNearestStops(geo::Coordinates point, size_t count) const;
+		// Stops inside the box ordered by name, bounds included. A box with min.lng > max.lng
+		// crosses the 180th meridian
+		std::vector<const Stop*> FindStopsInBox(geo::Coordinates min, geo::Coordinates max) const;
 	private:
 		std::deque<Stop> stops_;
 		std::deque<Bus> buses_;
@@ -36,8 +57,37 @@ namespace transport_catalogue {
 		std::unordered_map<std::string_view, Stop*> stops_as_catalogue_;
 		std::unordered_map<std::string_view, Bus*> buses_as_catalogue_;
 
-		std::unordered_map<std::pair<const Stop*, const Stop*>, int, StopPairHasher> distances_;
+		std::unordered_map<std::string_view, BusInfo> bus_infos_;
+
+		struct DistanceEntry {
+			StopId from = 0;
+			StopId to = 0;
+			int distance = 0;
+		};
+
+		// CSR table: distances from stop i are distances_[distance_offsets_[i], distance_offsets_[i + 1]).
+		// SetDistance only queues an entry, the table is rebuilt on the next lookup; readers may
+		// race on that first lookup, hence the lock
+		mutable std::vector<uint32_t> distance_offsets_;
+		mutable std::vector<RoadDistance> distances_;
+		// Entries that only mirror a distance set in the opposite direction
+		mutable std::vector<bool> mirrored_distances_;
+		mutable std::vector<DistanceEntry> pending_distances_;
+		mutable std::atomic<bool> distances_changed_ = false;
+		mutable std::mutex distances_mutex_;
+
+		// Stop coordinates as points on the unit sphere for nearest-stop searches (chord length
+		// grows with great-circle distance), and as (lat, lng) pairs for boxes. Both are rebuilt
+		// on the first query after a stop was added
+		mutable spatial_index::KdTree<3, StopId> stops_on_sphere_;
+		mutable spatial_index::KdTree<2, StopId> stops_on_map_;
+		mutable std::atomic<bool> stops_changed_ = false;
+		mutable std::mutex stop_index_mutex_;
 
+		void UpdateStopIndex() const;
+		void UpdateDistanceTable() const;
+		void RebuildDistanceTable() const;
+		BusInfo ComputeBusInfo(const Bus& bus) const;
 	};
 
 } //namespace catalogue
\ No newline at end of file
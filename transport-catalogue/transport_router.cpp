@@ -1,4 +1,6 @@
 #include "transport_router.h"
+
+#include <algorithm>
 #include <stdexcept>
 
 namespace transport_router {
@@ -9,71 +11,246 @@ namespace transport_router {
 	TransportRouter::TransportRouter(const TransportCatalogue& catalogue, RouterSettings settings) {
 		SetRouterSetting(settings);
 
-		graph::DirectedWeightedGraph<RouteWeight> graph(CountStops(catalogue));
+		const size_t stops_count = CountStops(catalogue);
+		const bool is_transfer_model = settings_.graph_model == GraphModel::TRANSFER;
+		graph::DirectedWeightedGraph<RouteWeight> graph(
+			is_transfer_model ? stops_count + CountBusVertices(catalogue) : stops_count
+		);
+		graph::VertexId next_bus_vertex = stops_count;
 		for (const auto& [bus_id, route] : catalogue.GetBuses()) {
 			std::vector<const Stop*> stops = route->stops;
-			BuildGraph(graph, catalogue, stops, bus_id);
+			std::vector<const Stop*> rstops;
 			if (!route->is_roundtrip) {
-				std::vector<const Stop*> rstops{ route->stops.rbegin(), route->stops.rend() };
-				BuildGraph(graph, catalogue, rstops, bus_id);
+				rstops.assign(route->stops.rbegin(), route->stops.rend());
+			}
+			if (is_transfer_model) {
+				next_bus_vertex = BuildTransferGraph(graph, catalogue, stops, bus_id, next_bus_vertex);
+				if (!route->is_roundtrip) {
+					next_bus_vertex = BuildTransferGraph(graph, catalogue, rstops, bus_id, next_bus_vertex);
+				}
+			}
+			else {
+				BuildGraph(graph, catalogue, stops, bus_id);
+				if (!route->is_roundtrip) {
+					BuildGraph(graph, catalogue, rstops, bus_id);
+				}
 			}
 		}
 		graph_ = std::move(graph);
-		router_ = std::make_unique<graph::Router<RouteWeight>>(graph::Router(graph_));
+		router_ = std::make_unique<graph::Router<RouteWeight>>(graph_, settings_.router_mode, settings_.router_threads);
+	}
+
+	std::shared_ptr<const RouteData> TransportRouter::BuildRouteData(const Stop* from, const Stop* to) const {
+		const graph::VertexId from_vertex = GetStopVertex(from);
+		const graph::VertexId to_vertex = GetStopVertex(to);
+		if (!router_ || from_vertex == NO_VERTEX || to_vertex == NO_VERTEX) {
+			return nullptr;
+		}
+		if (!route_cache_) {
+			return ComputeRouteData(from_vertex, to_vertex);
+		}
+
+		const uint64_t key = static_cast<uint64_t>(from->id) << 32 | to->id;
+		if (auto cached = route_cache_->Find(key)) {
+			return std::move(*cached);
+		}
+		auto route = ComputeRouteData(from_vertex, to_vertex);
+		route_cache_->Insert(key, route);
+		return route;
+	}
+
+	lru_cache::CacheStats TransportRouter::GetRouteCacheStats() const {
+		return route_cache_ ? route_cache_->GetStats() : lru_cache::CacheStats{};
+	}
+
+	std::vector<double> TransportRouter::BuildRouteTimes(const Stop* from, const std::vector<const Stop*>& to) const {
+		std::vector<double> times(to.size());
+		FillRouteTimes(from, to, times.data());
+		return times;
+	}
+
+	std::vector<double> TransportRouter::BuildRouteMatrix(const std::vector<const Stop*>& from, const std::vector<const Stop*>& to) const {
+		std::vector<double> times(from.size() * to.size());
+		auto fill_row = [this, &from, &to, &times](size_t row) {
+			FillRouteTimes(from[row], to, times.data() + row * to.size());
+		};
+
+		// Inside a stat request pool every core is already taken, a second pool would only oversubscribe them
+		if (settings_.router_threads == 1 || from.size() <= 1 || thread_pool::ThreadPool::IsRunningTask()) {
+			for (size_t row = 0; row < from.size(); ++row) {
+				fill_row(row);
+			}
+			return times;
+		}
+
+		std::call_once(matrix_pool_created_, [this] {
+			matrix_pool_ = std::make_unique<thread_pool::ThreadPool>(settings_.router_threads);
+		});
+		matrix_pool_->ParallelFor(from.size(), fill_row);
+		return times;
 	}
 
-	std::optional<RouteData> TransportRouter::BuildRouteData(std::string_view from, std::string_view to) const {
-		if (!router_) {
-			return std::nullopt;
+	void TransportRouter::FillRouteTimes(const Stop* from, const std::vector<const Stop*>& to, double* times) const {
+		std::fill(times, times + to.size(), NO_ROUTE);
+		const graph::VertexId from_vertex = GetStopVertex(from);
+		if (!router_ || from_vertex == NO_VERTEX) {
+			return;
 		}
 
-		const auto& route = router_->BuildRoute(stopname_to_id_.at(from), stopname_to_id_.at(to));
+		const auto weights = router_->BuildWeightsFrom(from_vertex);
+		for (size_t i = 0; i < to.size(); ++i) {
+			const graph::VertexId to_vertex = GetStopVertex(to[i]);
+			if (to_vertex != NO_VERTEX && weights[to_vertex]) {
+				times[i] = weights[to_vertex]->total_time;
+			}
+		}
+	}
+
+	std::vector<ReachableStop> TransportRouter::BuildIsochrone(const Stop* from, double max_time) const {
+		std::vector<ReachableStop> reachable;
+		const graph::VertexId from_vertex = GetStopVertex(from);
+		if (!router_ || from_vertex == NO_VERTEX) {
+			return reachable;
+		}
+
+		RouteWeight budget;
+		budget.total_time = max_time;
+		for (const auto& [vertex, weight] : router_->BuildWeightsWithin(from_vertex, budget)) {
+			// Bus vertices of the transfer model follow the stop vertices
+			if (vertex < vertex_stops_.size()) {
+				reachable.push_back({ vertex_stops_[vertex], weight.total_time });
+			}
+		}
+		std::sort(reachable.begin(), reachable.end(), [](const ReachableStop& lhs, const ReachableStop& rhs) {
+			return std::pair(lhs.time, std::string_view(lhs.stop->name)) < std::pair(rhs.time, std::string_view(rhs.stop->name));
+			});
+		return reachable;
+	}
+
+	graph::VertexId TransportRouter::GetStopVertex(const Stop* stop) const {
+		return stop->id < stop_vertices_.size() ? stop_vertices_[stop->id] : NO_VERTEX;
+	}
+
+	std::shared_ptr<const RouteData> TransportRouter::ComputeRouteData(graph::VertexId from, graph::VertexId to) const {
+		const auto& route = router_->BuildRoute(from, to);
 		if (!route) {
-			return std::nullopt;
+			return nullptr;
 		}
 
-		json::Array items;
-		items.reserve(route.value().edges.size());
+		std::vector<RouteItem> items = settings_.graph_model == GraphModel::TRANSFER
+			? BuildTransferItems(route->edges)
+			: BuildDirectItems(route->edges);
+		return std::make_shared<const RouteData>(RouteData{ std::move(items), route->weight.total_time });
+	}
+
+	std::vector<RouteItem> TransportRouter::BuildDirectItems(const std::vector<graph::EdgeId>& edges) const {
+		std::vector<RouteItem> items;
+		items.reserve(edges.size() * 2);
 
-		for (const auto& edge : route->edges) {
+		for (const auto& edge : edges) {
 			const auto& edge_info = graph_.GetEdge(edge);
 			auto wait_time = settings_.bus_wait_time;
 
-			items.emplace_back(json::Node(json::Builder{}
-				.StartDict()
-				.Key("stop_name"s).Value(std::string(id_to_stopname_.at(edge_info.from)))
-				.Key("time"s).Value(wait_time)
-				.Key("type"s).Value("Wait"s)
-				.EndDict()
-				.Build()
-			));
-			items.emplace_back(json::Node(json::Builder{}
-				.StartDict()
-				.Key("bus"s).Value(std::string(edge_info.weight.bus_name))
-				.Key("span_count"s).Value(edge_info.weight.span_count)
-				.Key("time"s).Value(edge_info.weight.total_time - wait_time)
-				.Key("type"s).Value("Bus"s)
-				.EndDict()
-				.Build()
-			));
-		}
-		return RouteData{ items, route->weight.total_time};
+			items.push_back({ RouteItemType::WAIT, vertex_stops_[edge_info.from]->name, wait_time });
+			items.push_back({ RouteItemType::BUS, edge_info.weight.bus_name, edge_info.weight.total_time - wait_time, edge_info.weight.span_count });
+		}
+		return items;
+	}
+
+	std::vector<RouteItem> TransportRouter::BuildTransferItems(const std::vector<graph::EdgeId>& edges) const {
+		std::vector<RouteItem> items;
+		RouteWeight ride;
+		for (const auto& edge : edges) {
+			const auto& edge_info = graph_.GetEdge(edge);
+			switch (edge_info.weight.type) {
+			case EdgeType::WAIT:
+				items.push_back({ RouteItemType::WAIT, vertex_stops_[edge_info.from]->name, edge_info.weight.total_time });
+				// The ride starts from the wait, as the cumulative edges of the direct model do,
+				// so both models round the printed bus time the same way
+				ride = { edge_info.weight.bus_name, edge_info.weight.total_time, 0, EdgeType::RIDE };
+				break;
+			case EdgeType::RIDE:
+				ride.total_time += edge_info.weight.total_time;
+				ride.span_count += edge_info.weight.span_count;
+				break;
+			case EdgeType::ALIGHT:
+				items.push_back({ RouteItemType::BUS, ride.bus_name, ride.total_time - settings_.bus_wait_time, ride.span_count });
+				break;
+			case EdgeType::BUS:
+				throw std::logic_error("Direct bus edge in transfer graph"s);
+			}
+		}
+		return items;
 	}
 
 	void TransportRouter::SetRouterSetting(RouterSettings settings) {
 		settings_ = settings;
+		route_cache_ = settings_.route_cache_size > 0 ? std::make_unique<RouteCache>(settings_.route_cache_size) : nullptr;
+	}
+
+	const RouterSettings& TransportRouter::GetRouterSettings() const {
+		return settings_;
+	}
+
+	const graph::DirectedWeightedGraph<RouteWeight>& TransportRouter::GetGraph() const {
+		return graph_;
+	}
+
+	const graph::Router<RouteWeight>* TransportRouter::GetRouter() const {
+		return router_.get();
+	}
+
+	size_t TransportRouter::GetStopVertexCount() const {
+		return vertex_stops_.size();
+	}
+
+	const Stop* TransportRouter::GetVertexStop(graph::VertexId vertex) const {
+		return vertex_stops_.at(vertex);
+	}
+
+	void TransportRouter::RestoreGraph(
+		RouterSettings settings,
+		const std::vector<const Stop*>& vertex_stops,
+		graph::DirectedWeightedGraph<RouteWeight> graph
+	) {
+		SetRouterSetting(settings);
+		router_.reset();
+		SetVertexStops(vertex_stops);
+		graph_ = std::move(graph);
+	}
+
+	void TransportRouter::RestoreRouter(std::unique_ptr<graph::Router<RouteWeight>> router) {
+		router_ = std::move(router);
 	}
 
 	size_t TransportRouter::CountStops(const TransportCatalogue& catalogue) {
-		size_t stops_counter = 0;
-		const auto& stops = catalogue.GetStops();
-		stopname_to_id_.reserve(stops.size());
-		id_to_stopname_.reserve(stops.size());
-		for (const auto& stop : stops) {
-			stopname_to_id_.insert({ stop.first, stops_counter });
-			id_to_stopname_.insert({ stops_counter++, stop.first });
+		std::vector<const Stop*> vertex_stops;
+		vertex_stops.reserve(catalogue.GetStops().size());
+		for (const auto& [name, stop] : catalogue.GetStops()) {
+			vertex_stops.push_back(stop);
 		}
-		return stops_counter;
+		SetVertexStops(std::move(vertex_stops));
+		return vertex_stops_.size();
+	}
+
+	void TransportRouter::SetVertexStops(std::vector<const Stop*> vertex_stops) {
+		vertex_stops_ = std::move(vertex_stops);
+		stop_vertices_.clear();
+		for (graph::VertexId vertex = 0; vertex < vertex_stops_.size(); ++vertex) {
+			const StopId stop = vertex_stops_[vertex]->id;
+			if (stop >= stop_vertices_.size()) {
+				stop_vertices_.resize(stop + 1, NO_VERTEX);
+			}
+			stop_vertices_[stop] = vertex;
+		}
+	}
+
+	size_t TransportRouter::CountBusVertices(const TransportCatalogue& catalogue) const {
+		size_t vertices_counter = 0;
+		for (const auto& [bus_id, route] : catalogue.GetBuses()) {
+			vertices_counter += route->is_roundtrip ? route->stops.size() : route->stops.size() * 2;
+		}
+		return vertices_counter;
 	}
 
 	double TransportRouter::ComputeRouteTime(const TransportCatalogue& catalogue, const Stop* from, const Stop* to) const {
@@ -94,11 +271,32 @@ namespace transport_router {
 			for (size_t j = i + 1; j < stops.size(); ++j) {
 				auto to = stops[j];
 				route_time += ComputeRouteTime(catalogue, stops[j - 1], to);
-				graph.AddEdge({ stopname_to_id_[from->name], stopname_to_id_[to->name], {bus_id, route_time, span_count++ } });
+				graph.AddEdge({ stop_vertices_[from->id], stop_vertices_[to->id], {bus_id, route_time, span_count++ } });
+			}
+		}
+	}
+
+	graph::VertexId TransportRouter::BuildTransferGraph(
+		graph::DirectedWeightedGraph<RouteWeight>& graph,
+		const TransportCatalogue& catalogue,
+		const std::vector<const Stop*>& stops,
+		std::string_view bus_id,
+		graph::VertexId first_bus_vertex
+	) {
+		for (size_t i = 0; i < stops.size(); ++i) {
+			const graph::VertexId stop_vertex = stop_vertices_[stops[i]->id];
+			const graph::VertexId bus_vertex = first_bus_vertex + i;
+			if (i + 1 < stops.size()) {
+				graph.AddEdge({ stop_vertex, bus_vertex, { bus_id, settings_.bus_wait_time, 0, EdgeType::WAIT } });
+				graph.AddEdge({ bus_vertex, bus_vertex + 1, { bus_id, ComputeRouteTime(catalogue, stops[i], stops[i + 1]), 1, EdgeType::RIDE } });
+			}
+			if (i > 0) {
+				graph.AddEdge({ bus_vertex, stop_vertex, { bus_id, 0, 0, EdgeType::ALIGHT } });
 			}
 		}
+		return first_bus_vertex + stops.size();
 	}
-	
+
 	bool operator<(const RouteWeight& left, const RouteWeight& right) {
 		return left.total_time < right.total_time;
 	}
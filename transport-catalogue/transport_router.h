@@ -1,32 +1,76 @@
 #pragma once
 
 #include "transport_catalogue.h"
-#include "json_builder.h"
 #include "router.h"
+#include "lru_cache.h"
+#include "thread_pool.h"
 
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 namespace transport_router {
 
 	//   /  /
 	constexpr static double KPH_TO_MPM = 1000.0 / 60.0;
 
+	// DIRECT: one edge from every stop to every later stop of the same bus (wait + ride),
+	// TRANSFER: (bus, stop) vertices with separate wait/ride/alight edges, linear in route length
+	enum class GraphModel {
+		DIRECT,
+		TRANSFER,
+	};
+
+	enum class EdgeType {
+		BUS,
+		WAIT,
+		RIDE,
+		ALIGHT,
+	};
+
 	struct RouteWeight {
 		std::string_view bus_name;
 		double total_time = 0;
 		int span_count = 0;
+		EdgeType type = EdgeType::BUS;
 	};
 
 	struct RouterSettings {
 		double bus_wait_time = 0;
 		double bus_velocity = 0;
+		graph::RouterMode router_mode = graph::RouterMode::EAGER;
+		GraphModel graph_model = GraphModel::DIRECT;
+		// 0 - one thread per hardware core
+		size_t router_threads = 0;
+		// Routes kept for repeated queries, 0 turns the cache off
+		size_t route_cache_size = 4096;
+	};
+
+	enum class RouteItemType {
+		WAIT,
+		BUS,
+	};
+
+	// Names point into the catalogue: the stop name for WAIT, the bus number for BUS
+	struct RouteItem {
+		RouteItemType type = RouteItemType::WAIT;
+		std::string_view name;
+		double time = 0;
+		int span_count = 0;
 	};
 
 	struct RouteData {
-		json::Array data;
+		std::vector<RouteItem> items;
 		double total_time;
 	};
 
+	struct ReachableStop {
+		const transport_catalogue::Stop* stop = nullptr;
+		double time = 0;
+	};
+
 	class TransportRouter {
 	public:
 		TransportRouter() = default;
@@ -34,10 +78,42 @@ namespace transport_router {
 
 		void SetRouterSetting(RouterSettings settings);
 
-		std::optional<RouteData> BuildRouteData(std::string_view from, std::string_view to) const;
+		// nullptr when there is no route. Answers are shared with the route cache, so repeated
+		// queries for a popular pair are neither recomputed nor copied
+		std::shared_ptr<const RouteData> BuildRouteData(const transport_catalogue::Stop* from, const transport_catalogue::Stop* to) const;
+		lru_cache::CacheStats GetRouteCacheStats() const;
+
+		// Travel times from one stop to each of `to`, in the same order, NO_ROUTE where there is none
+		std::vector<double> BuildRouteTimes(const transport_catalogue::Stop* from, const std::vector<const transport_catalogue::Stop*>& to) const;
+		// Row-major from.size() x to.size() times, one search per origin. Origins run on the router's
+		// pool of router_threads threads, or serially when called from a task of another pool.
+		std::vector<double> BuildRouteMatrix(
+			const std::vector<const transport_catalogue::Stop*>& from,
+			const std::vector<const transport_catalogue::Stop*>& to
+		) const;
+
+		// Stops reachable from `from` within max_time minutes, the origin included, ordered by time and then name
+		std::vector<ReachableStop> BuildIsochrone(const transport_catalogue::Stop* from, double max_time) const;
+
+		static constexpr double NO_ROUTE = std::numeric_limits<double>::infinity();
+
+		// Snapshot support: the graph is restored first, then a router built over GetGraph()
+		const RouterSettings& GetRouterSettings() const;
+		const graph::DirectedWeightedGraph<RouteWeight>& GetGraph() const;
+		const graph::Router<RouteWeight>* GetRouter() const;
+		size_t GetStopVertexCount() const;
+		const transport_catalogue::Stop* GetVertexStop(graph::VertexId vertex) const;
+
+		void RestoreGraph(
+			RouterSettings settings,
+			const std::vector<const transport_catalogue::Stop*>& vertex_stops,
+			graph::DirectedWeightedGraph<RouteWeight> graph
+		);
+		void RestoreRouter(std::unique_ptr<graph::Router<RouteWeight>> router);
 
 	private:
 		size_t CountStops(const transport_catalogue::TransportCatalogue& catalogue);
+		size_t CountBusVertices(const transport_catalogue::TransportCatalogue& catalogue) const;
 
 		double ComputeRouteTime(
 			const transport_catalogue::TransportCatalogue& catalogue,
@@ -52,14 +128,56 @@ namespace transport_router {
 			std::string_view bus_id
 		);
 
+		graph::VertexId BuildTransferGraph(
+			graph::DirectedWeightedGraph<RouteWeight>& graph,
+			const transport_catalogue::TransportCatalogue& catalogue,
+			const std::vector<const transport_catalogue::Stop*>& stops,
+			std::string_view bus_id,
+			graph::VertexId first_bus_vertex
+		);
+
+		std::vector<RouteItem> BuildDirectItems(const std::vector<graph::EdgeId>& edges) const;
+		std::vector<RouteItem> BuildTransferItems(const std::vector<graph::EdgeId>& edges) const;
+		void SetVertexStops(std::vector<const transport_catalogue::Stop*> vertex_stops);
+
+		static constexpr graph::VertexId NO_VERTEX = std::numeric_limits<graph::VertexId>::max();
+
 		RouterSettings settings_;
-		std::unordered_map<std::string_view, uint32_t> stopname_to_id_;
-		std::unordered_map<uint32_t, std::string_view> id_to_stopname_;
+		// Stop vertices come first in the graph; both directions are plain arrays, by vertex and by stop id
+		std::vector<const transport_catalogue::Stop*> vertex_stops_;
+		std::vector<graph::VertexId> stop_vertices_;
 		std::unique_ptr<graph::Router<RouteWeight>> router_ = nullptr;
 		graph::DirectedWeightedGraph<RouteWeight> graph_;
+
+		// Keyed by (from stop id << 32) | to stop id
+		using RouteCache = lru_cache::LruCache<uint64_t, std::shared_ptr<const RouteData>>;
+		std::unique_ptr<RouteCache> route_cache_;
+
+		// Shared by all matrix requests, created by the first one
+		mutable std::once_flag matrix_pool_created_;
+		mutable std::unique_ptr<thread_pool::ThreadPool> matrix_pool_;
+
+		std::shared_ptr<const RouteData> ComputeRouteData(graph::VertexId from, graph::VertexId to) const;
+		graph::VertexId GetStopVertex(const transport_catalogue::Stop* stop) const;
+		void FillRouteTimes(const transport_catalogue::Stop* from, const std::vector<const transport_catalogue::Stop*>& to, double* times) const;
 	};
 
 	bool operator<(const RouteWeight& left, const RouteWeight& right);
 	bool operator>(const RouteWeight& left, const RouteWeight& right);
 	RouteWeight operator+(const RouteWeight& left, const RouteWeight& right);
-}
\ No newline at end of file
+}
+
+namespace graph {
+
+	template <>
+	struct WeightTraits<transport_router::RouteWeight> {
+		using Value = double;
+
+		static Value ToValue(const transport_router::RouteWeight& weight) {
+			return weight.total_time;
+		}
+		static transport_router::RouteWeight FromValue(Value value) {
+			return { {}, value, 0 };
+		}
+	};
+} // namespace graph
\ No newline at end of file